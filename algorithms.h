@@ -0,0 +1,251 @@
+#ifndef ALGORITHMS_H_
+#define ALGORITHMS_H_
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+// Parallel algorithms never split work into pieces smaller than this many elements
+const size_t kParallelGrain = size_t{1} << 15;
+
+// Fixed set of worker threads. The thread that calls ParallelFor takes a share of the work and, while waiting,
+// runs queued tasks itself, so nested ParallelFor calls cannot deadlock the pool
+class ThreadPool {
+ public:
+  // Constructors
+  explicit ThreadPool(size_t threads = std::max(std::thread::hardware_concurrency(), 1U)) {
+    for (size_t i = 1; i < threads; ++i) {
+      workers_.emplace_back([this] { WorkerLoop(); });
+    }
+  }
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto& worker : workers_) {
+      worker.join();
+    }
+  }
+
+  // Methods
+  size_t ThreadCount() const {
+    return workers_.size() + 1;
+  }
+
+  // Calls body(begin, end) on disjoint pieces covering [0, count), each at least `grain` long, and returns once
+  // all of them are done. The first exception thrown by a piece is rethrown here
+  template <class F>
+  void ParallelFor(size_t count, size_t grain, F&& body) {
+    size_t pieces = std::min(ThreadCount(), count / std::max(grain, size_t{1}));
+    if (pieces <= 1) {
+      if (count != 0) {
+        body(size_t{0}, count);
+      }
+      return;
+    }
+    size_t remaining = pieces - 1;
+    std::exception_ptr error;
+    std::mutex done_mutex;
+    std::condition_variable done;
+    auto run = [&](size_t piece) {
+      try {
+        body(count * piece / pieces, count * (piece + 1) / pieces);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(done_mutex);
+        if (!error) {
+          error = std::current_exception();
+        }
+      }
+    };
+    for (size_t piece = 1; piece < pieces; ++piece) {
+      Submit([&, piece] {
+        run(piece);
+        std::lock_guard<std::mutex> lock(done_mutex);
+        if (--remaining == 0) {
+          done.notify_one();
+        }
+      });
+    }
+    run(0);
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(done_mutex);
+        if (remaining == 0) {
+          break;
+        }
+      }
+      if (!RunOne()) {
+        std::unique_lock<std::mutex> lock(done_mutex);
+        done.wait(lock, [&] { return remaining == 0; });
+        break;
+      }
+    }
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+
+ private:
+  std::vector<std::thread> workers_;
+  std::deque<std::function<void()>> tasks_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  bool stop_ = false;
+
+  void Submit(std::function<void()> task) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      tasks_.push_back(std::move(task));
+    }
+    wake_.notify_one();
+  }
+
+  bool RunOne() {
+    std::function<void()> task;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (tasks_.empty()) {
+        return false;
+      }
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+    task();
+    return true;
+  }
+
+  void WorkerLoop() {
+    while (true) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        wake_.wait(lock, [this] { return stop_ || !tasks_.empty(); });
+        if (tasks_.empty()) {
+          return;
+        }
+        task = std::move(tasks_.front());
+        tasks_.pop_front();
+      }
+      task();
+    }
+  }
+};
+
+inline ThreadPool& DefaultThreadPool() {
+  static ThreadPool pool;
+  return pool;
+}
+
+// Parallel algorithms over any container with Data() and Size(), such as Vector and Array. Inputs shorter than two
+// grains run on the calling thread
+
+template <class Container, class T>
+void ParallelFill(Container& container, const T& value, ThreadPool& pool = DefaultThreadPool()) {
+  if (container.Size() == 0) {
+    return;
+  }
+  auto* data = container.Data();
+  pool.ParallelFor(container.Size(), kParallelGrain, [&](size_t begin, size_t end) {
+    std::fill(data + begin, data + end, value);
+  });
+}
+
+// out[i] = op(in[i]) for every i; `out` must hold at least in.Size() elements
+template <class In, class Out, class UnaryOp>
+void ParallelTransform(const In& in, Out& out, UnaryOp op, ThreadPool& pool = DefaultThreadPool()) {
+  if (in.Size() == 0) {
+    return;
+  }
+  const auto* src = in.Data();
+  auto* dst = out.Data();
+  pool.ParallelFor(in.Size(), kParallelGrain, [&](size_t begin, size_t end) {
+    std::transform(src + begin, src + end, dst + begin, op);
+  });
+}
+
+// Folds the elements in order into `init`; pieces are reduced separately and then combined left to right, so
+// `op` has to be associative but not commutative
+template <class Container, class T, class BinaryOp = std::plus<>>
+T ParallelReduce(const Container& container, T init, BinaryOp op = BinaryOp(),
+                 ThreadPool& pool = DefaultThreadPool()) {
+  size_t size = container.Size();
+  if (size == 0) {
+    return init;
+  }
+  const auto* data = container.Data();
+  size_t pieces = std::min(pool.ThreadCount(), size / kParallelGrain);
+  if (pieces <= 1) {
+    return std::accumulate(data, data + size, init, op);
+  }
+  std::vector<T> partial(pieces, init);
+  pool.ParallelFor(pieces, 1, [&](size_t first, size_t last) {
+    for (size_t piece = first; piece < last; ++piece) {
+      size_t begin = size * piece / pieces;
+      size_t end = size * (piece + 1) / pieces;
+      T acc = data[begin];
+      for (size_t i = begin + 1; i < end; ++i) {
+        acc = op(std::move(acc), data[i]);
+      }
+      partial[piece] = std::move(acc);
+    }
+  });
+  for (auto& value : partial) {
+    init = op(std::move(init), std::move(value));
+  }
+  return init;
+}
+
+// Sorts pieces in parallel, then merges neighbouring runs pairwise, halving the number of runs each round
+template <class Container, class Compare = std::less<>>
+void ParallelSort(Container& container, Compare comp = Compare(), ThreadPool& pool = DefaultThreadPool()) {
+  size_t size = container.Size();
+  if (size == 0) {
+    return;
+  }
+  auto* data = container.Data();
+  size_t pieces = std::min(pool.ThreadCount(), size / kParallelGrain);
+  if (pieces <= 1) {
+    std::sort(data, data + size, comp);
+    return;
+  }
+  std::vector<size_t> bounds(pieces + 1);
+  for (size_t piece = 0; piece <= pieces; ++piece) {
+    bounds[piece] = size * piece / pieces;
+  }
+  pool.ParallelFor(pieces, 1, [&](size_t first, size_t last) {
+    for (size_t piece = first; piece < last; ++piece) {
+      std::sort(data + bounds[piece], data + bounds[piece + 1], comp);
+    }
+  });
+  while (bounds.size() > 2) {
+    size_t runs = bounds.size() - 1;
+    pool.ParallelFor(runs / 2, 1, [&](size_t first, size_t last) {
+      for (size_t pair = first; pair < last; ++pair) {
+        std::inplace_merge(data + bounds[2 * pair], data + bounds[2 * pair + 1], data + bounds[2 * pair + 2], comp);
+      }
+    });
+    std::vector<size_t> merged;
+    for (size_t i = 0; i < bounds.size(); i += 2) {
+      merged.push_back(bounds[i]);
+    }
+    if (merged.back() != size) {
+      merged.push_back(size);
+    }
+    bounds = std::move(merged);
+  }
+}
+
+#endif  // ALGORITHMS_H_
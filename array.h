@@ -5,6 +5,9 @@
 
 #include <cstddef>
 #include <stdexcept>
+#include <utility>
+
+#include "range_compare.h"
 
 class ArrayOutOfRange : public std::out_of_range {
  public:
@@ -100,6 +103,31 @@ class Array {
       std::swap(store_[i], other.store_[i]);
     }
   }
+
+  // Compare operators
+  friend bool operator==(const Array& left, const Array& right) {
+    return RangeEqual(left.store_, right.store_, S);
+  }
+
+  friend bool operator!=(const Array& left, const Array& right) {
+    return !(left == right);  // NOLINT
+  }
+
+  friend bool operator<(const Array& left, const Array& right) {
+    return RangeLess(left.store_, S, right.store_, S);
+  }
+
+  friend bool operator<=(const Array& left, const Array& right) {
+    return !(right < left);  // NOLINT
+  }
+
+  friend bool operator>(const Array& left, const Array& right) {
+    return right < left;  // NOLINT
+  }
+
+  friend bool operator>=(const Array& left, const Array& right) {
+    return !(left < right);  // NOLINT
+  }
 };
 
 // Additional
@@ -0,0 +1,160 @@
+#ifndef CONCURRENT_UNORDERED_SET_H_
+#define CONCURRENT_UNORDERED_SET_H_
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include "hash_mix.h"
+#include "unordered_set.h"
+
+const size_t kCacheLineSize = 64;
+const size_t kDefaultShardCount = 64;
+
+// Thread-safe set split into independently locked UnorderedSet shards. A key's shard comes from the top bits of
+// its mixed hash, so it stays independent of the bucket index the shard computes from the low bits
+template <class KeyT, class Hash = SetHash<KeyT>, class KeyEqual = std::equal_to<>,
+          class Allocator = std::allocator<KeyT>>
+class ConcurrentUnorderedSet {
+ public:
+  // Constructors
+  explicit ConcurrentUnorderedSet(size_t shard_count = kDefaultShardCount, const Hash& hash = Hash(),
+                                  const KeyEqual& equal = KeyEqual(), const Allocator& alloc = Allocator())
+      : hasher_(hash) {
+    while ((size_t{1} << shard_bits_) < shard_count) {
+      ++shard_bits_;
+    }
+    shards_ = std::make_unique<Shard[]>(ShardCount());
+    for (size_t i = 0; i < ShardCount(); ++i) {
+      shards_[i].set = ShardSet(0, hash, equal, alloc);
+    }
+  }
+
+  ConcurrentUnorderedSet(const ConcurrentUnorderedSet&) = delete;
+  ConcurrentUnorderedSet& operator=(const ConcurrentUnorderedSet&) = delete;
+
+  // Methods
+  size_t ShardCount() const {
+    return size_t{1} << shard_bits_;
+  }
+
+  // Sum of per-shard counters read without locking; exact only while no writer is running
+  size_t Size() const {
+    size_t size = 0;
+    for (size_t i = 0; i < ShardCount(); ++i) {
+      size += shards_[i].size.load(std::memory_order_relaxed);
+    }
+    return size;
+  }
+
+  bool Empty() const {
+    return Size() == 0;
+  }
+
+  void Clear() {
+    for (size_t i = 0; i < ShardCount(); ++i) {
+      std::lock_guard<std::mutex> lock(shards_[i].mutex);
+      shards_[i].set.Clear();
+      shards_[i].size.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  void Reserve(size_t count) {
+    for (size_t i = 0; i < ShardCount(); ++i) {
+      std::lock_guard<std::mutex> lock(shards_[i].mutex);
+      shards_[i].set.Reserve(count / ShardCount() + 1);
+    }
+  }
+
+  // Visits every key one shard at a time, holding only that shard's lock; keys inserted or erased in other shards
+  // during the walk may or may not be seen
+  template <class F>
+  void ForEach(F&& visit) const {
+    for (size_t i = 0; i < ShardCount(); ++i) {
+      std::lock_guard<std::mutex> lock(shards_[i].mutex);
+      shards_[i].set.ForEach(visit);
+    }
+  }
+
+  bool Find(const KeyT& key) const {
+    return FindKey(key);
+  }
+
+  template <class K, class = EnableIfTransparent<Hash, KeyEqual, K>>
+  bool Find(const K& key) const {
+    return FindKey(key);
+  }
+
+  bool Insert(const KeyT& key) {
+    Shard& shard = ShardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (!shard.set.Insert(key)) {
+      return false;
+    }
+    shard.size.store(shard.set.Size(), std::memory_order_relaxed);
+    return true;
+  }
+
+  bool Insert(KeyT&& key) {
+    Shard& shard = ShardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (!shard.set.Insert(std::move(key))) {
+      return false;
+    }
+    shard.size.store(shard.set.Size(), std::memory_order_relaxed);
+    return true;
+  }
+
+  bool Erase(const KeyT& key) {
+    return EraseKey(key);
+  }
+
+  template <class K, class = EnableIfTransparent<Hash, KeyEqual, K>>
+  bool Erase(const K& key) {
+    return EraseKey(key);
+  }
+
+ private:
+  using ShardSet = UnorderedSet<KeyT, Hash, KeyEqual, Allocator>;
+
+  // Each shard owns whole cache lines so neighbouring locks and counters never false-share
+  struct alignas(kCacheLineSize) Shard {
+    mutable std::mutex mutex;
+    std::atomic<size_t> size{0};
+    ShardSet set;
+  };
+
+  Hash hasher_;
+  size_t shard_bits_ = 0;
+  std::unique_ptr<Shard[]> shards_;
+
+  template <class K>
+  Shard& ShardOf(const K& key) const {
+    if (shard_bits_ == 0) {
+      return shards_[0];
+    }
+    return shards_[MixHash(hasher_(key)) >> (sizeof(size_t) * 8 - shard_bits_)];
+  }
+
+  template <class K>
+  bool FindKey(const K& key) const {
+    Shard& shard = ShardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.set.Find(key);
+  }
+
+  template <class K>
+  bool EraseKey(const K& key) {
+    Shard& shard = ShardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (!shard.set.Erase(key)) {
+      return false;
+    }
+    shard.size.store(shard.set.Size(), std::memory_order_relaxed);
+    return true;
+  }
+};
+
+#endif  // CONCURRENT_UNORDERED_SET_H_
@@ -0,0 +1,182 @@
+#ifndef CONTROL_BLOCK_POOL_H_
+#define CONTROL_BLOCK_POOL_H_
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+
+struct ControlBlockPoolStats {
+  // Allocations served from the free lists
+  size_t hits = 0;
+  // Allocations that went to operator new: empty list, or a block too big or too aligned to pool
+  size_t misses = 0;
+};
+
+// Per-thread cache of freed small blocks, one free list per 16-byte size class. Blocks come from plain operator new
+// and are never tied to the thread that allocated them, so a block freed on another thread simply joins that
+// thread's lists. Each list keeps at most kMaxCached blocks and gives the rest back to operator delete, so a
+// thread that only frees cannot hoard memory
+class ControlBlockPool {
+ public:
+  static constexpr size_t kClassSize = 16;
+  static constexpr size_t kClassCount = 16;
+  static constexpr size_t kMaxPooledSize = kClassSize * kClassCount;
+  static constexpr size_t kMaxCached = 4096;
+
+  // Constructors
+  ControlBlockPool() = default;
+
+  ControlBlockPool(const ControlBlockPool&) = delete;
+  ControlBlockPool& operator=(const ControlBlockPool&) = delete;
+
+  ~ControlBlockPool() {
+    for (auto*& head : free_) {
+      while (head != nullptr) {
+        Block* next = head->next;
+        ::operator delete(head);
+        head = next;
+      }
+    }
+    Closed() = true;
+  }
+
+  // The calling thread's pool, or nullptr while thread-local objects are being destroyed after it
+  static ControlBlockPool* Local() {
+    if (Closed()) {
+      return nullptr;
+    }
+    thread_local ControlBlockPool pool;
+    return &pool;
+  }
+
+  // Methods
+  void* Allocate(size_t bytes, size_t align) {
+    if (!IsPooled(bytes, align)) {
+      ++stats_.misses;
+      return ::operator new(bytes, static_cast<std::align_val_t>(align));
+    }
+    size_t cls = ClassOf(bytes);
+    if (free_[cls] == nullptr) {
+      ++stats_.misses;
+      return ::operator new((cls + 1) * kClassSize);
+    }
+    ++stats_.hits;
+    Block* block = free_[cls];
+    free_[cls] = block->next;
+    --cached_[cls];
+    return block;
+  }
+
+  void Deallocate(void* ptr, size_t bytes, size_t align) {
+    if (!IsPooled(bytes, align)) {
+      ::operator delete(ptr, static_cast<std::align_val_t>(align));
+      return;
+    }
+    size_t cls = ClassOf(bytes);
+    if (cached_[cls] == kMaxCached) {
+      ::operator delete(ptr);
+      return;
+    }
+    auto* block = static_cast<Block*>(ptr);
+    block->next = free_[cls];
+    free_[cls] = block;
+    ++cached_[cls];
+  }
+
+  const ControlBlockPoolStats& Stats() const {
+    return stats_;
+  }
+
+  void ResetStats() {
+    stats_ = ControlBlockPoolStats();
+  }
+
+  // Blocks currently waiting in the free lists
+  size_t Cached() const {
+    size_t total = 0;
+    for (size_t count : cached_) {
+      total += count;
+    }
+    return total;
+  }
+
+  // Allocation and release that bypass the lists but agree with them on how each block size is obtained, for
+  // threads whose pool is already gone
+  static void* AllocateUnpooled(size_t bytes, size_t align) {
+    if (IsPooled(bytes, align)) {
+      return ::operator new((ClassOf(bytes) + 1) * kClassSize);
+    }
+    return ::operator new(bytes, static_cast<std::align_val_t>(align));
+  }
+
+  static void DeallocateUnpooled(void* ptr, size_t bytes, size_t align) {
+    if (IsPooled(bytes, align)) {
+      ::operator delete(ptr);
+    } else {
+      ::operator delete(ptr, static_cast<std::align_val_t>(align));
+    }
+  }
+
+ private:
+  struct Block {
+    Block* next;
+  };
+
+  Block* free_[kClassCount] = {};
+  size_t cached_[kClassCount] = {};
+  ControlBlockPoolStats stats_;
+
+  // Trivially destructible, so it can still be read while other thread-local objects are torn down
+  static bool& Closed() {
+    thread_local bool closed = false;
+    return closed;
+  }
+
+  static bool IsPooled(size_t bytes, size_t align) {
+    return bytes != 0 && bytes <= kMaxPooledSize && align <= __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+  }
+
+  static size_t ClassOf(size_t bytes) {
+    return (bytes - 1) / kClassSize;
+  }
+};
+
+// Allocator over the calling thread's ControlBlockPool. SharedPtr(T*) takes its control blocks from it, and it can
+// be handed to AllocateShared to pool whole objects as well
+template <class T>
+class PoolAllocator {
+ public:
+  using value_type = T;
+  using is_always_equal = std::true_type;
+
+  PoolAllocator() noexcept = default;
+
+  template <class U>
+  PoolAllocator(const PoolAllocator<U>&) noexcept {  // NOLINT
+  }
+
+  T* allocate(size_t n) {  // NOLINT
+    if (auto* pool = ControlBlockPool::Local()) {
+      return static_cast<T*>(pool->Allocate(n * sizeof(T), alignof(T)));
+    }
+    return static_cast<T*>(ControlBlockPool::AllocateUnpooled(n * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T* ptr, size_t n) {  // NOLINT
+    if (auto* pool = ControlBlockPool::Local()) {
+      pool->Deallocate(ptr, n * sizeof(T), alignof(T));
+      return;
+    }
+    ControlBlockPool::DeallocateUnpooled(ptr, n * sizeof(T), alignof(T));
+  }
+
+  friend bool operator==(const PoolAllocator&, const PoolAllocator&) {
+    return true;
+  }
+
+  friend bool operator!=(const PoolAllocator&, const PoolAllocator&) {
+    return false;
+  }
+};
+
+#endif  // CONTROL_BLOCK_POOL_H_
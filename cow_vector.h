@@ -0,0 +1,269 @@
+#ifndef COW_VECTOR_H_
+#define COW_VECTOR_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <stdexcept>
+#include <utility>
+
+#include "shared_ptr.h"
+#include "vector.h"
+
+// Immutable view of the first Size() elements of a CowVector buffer. It keeps the buffer alive on its own, so it
+// stays valid and unchanged whatever the CowVector does afterwards, and can be read from any thread
+template <class T>
+class VectorSnapshot {
+ public:
+  using ConstIterator = const T*;
+
+  // Constructors
+  VectorSnapshot() = default;
+
+  // Methods
+  size_t Size() const {
+    return size_;
+  }
+
+  bool Empty() const {
+    return size_ == 0;
+  }
+
+  const T& operator[](size_t idx) const {
+    return data_[idx];
+  }
+
+  const T& At(size_t idx) const {
+    if (idx >= size_) {
+      throw std::out_of_range("Index overcomes border");
+    }
+    return data_[idx];
+  }
+
+  const T& Front() const {
+    return data_[0];
+  }
+
+  const T& Back() const {
+    return data_[size_ - 1];
+  }
+
+  const T* Data() const {
+    return data_;
+  }
+
+  // Iterators
+  ConstIterator begin() const {  // NOLINT
+    return data_;
+  }
+
+  ConstIterator end() const {  // NOLINT
+    return data_ + size_;
+  }
+
+ private:
+  template <class>
+  friend class CowVector;
+
+  SharedPtr<Vector<T>> buffer_;
+  const T* data_ = nullptr;
+  size_t size_ = 0;
+
+  VectorSnapshot(SharedPtr<Vector<T>> buffer, size_t size)
+      : buffer_(std::move(buffer)), data_(buffer_ ? buffer_->Data() : nullptr), size_(size) {
+  }
+};
+
+// Vector whose copies and snapshots share one buffer. Snapshot() is O(1). Appends go straight into the shared
+// buffer's spare capacity, past the end of every snapshot, so a writer can keep appending while readers hold
+// snapshots; once the buffer is full the writer moves on to a bigger copy and the readers keep the old one.
+// Changing or removing an element that someone else can see copies the buffer first; the check that nobody else
+// can see it (SharedPtr::Unique) is an acquire, so it orders after the last read of a snapshot dropped elsewhere.
+// One thread writes to a CowVector (and takes its snapshots); snapshots may be read from any thread
+template <class T>
+class CowVector {
+ public:
+  using ConstIterator = const T*;
+
+  // Constructors
+  CowVector() = default;
+
+  CowVector(std::initializer_list<T> init)
+      : buffer_(MakeShared<Vector<T>>(init)), size_(init.size()), owns_tail_(true) {
+  }
+
+  explicit CowVector(Vector<T>&& items)
+      : buffer_(MakeShared<Vector<T>>(std::move(items))), size_(buffer_->Size()), owns_tail_(true) {
+  }
+
+  // A copy shares the buffer but never appends to it: its first mutation gives it a buffer of its own
+  CowVector(const CowVector& copy) : buffer_(copy.buffer_), size_(copy.size_) {
+  }
+
+  CowVector(CowVector&& move) noexcept
+      : buffer_(std::move(move.buffer_)), size_(move.size_), owns_tail_(move.owns_tail_) {
+    move.size_ = 0;
+    move.owns_tail_ = false;
+  }
+
+  CowVector& operator=(const CowVector& copy) {
+    if (this != &copy) {
+      buffer_ = copy.buffer_;
+      size_ = copy.size_;
+      owns_tail_ = false;
+    }
+    return *this;
+  }
+
+  CowVector& operator=(CowVector&& move) noexcept {
+    if (this != &move) {
+      buffer_ = std::move(move.buffer_);
+      size_ = std::exchange(move.size_, 0);
+      owns_tail_ = std::exchange(move.owns_tail_, false);
+    }
+    return *this;
+  }
+
+  // Methods
+  VectorSnapshot<T> Snapshot() const {
+    return VectorSnapshot<T>(buffer_, size_);
+  }
+
+  size_t Size() const {
+    return size_;
+  }
+
+  bool Empty() const {
+    return size_ == 0;
+  }
+
+  bool IsShared() const {
+    return buffer_ && !buffer_.Unique();
+  }
+
+  const T& operator[](size_t idx) const {
+    return (*buffer_)[idx];
+  }
+
+  const T& At(size_t idx) const {
+    if (idx >= size_) {
+      throw std::out_of_range("Index overcomes border");
+    }
+    return (*buffer_)[idx];
+  }
+
+  const T& Front() const {
+    return (*buffer_)[0];
+  }
+
+  const T& Back() const {
+    return (*buffer_)[size_ - 1];
+  }
+
+  const T* Data() const {
+    return buffer_ ? buffer_->Data() : nullptr;
+  }
+
+  void PushBack(const T& value) {
+    EmplaceBack(value);
+  }
+
+  void PushBack(T&& value) {
+    EmplaceBack(std::move(value));
+  }
+
+  // Moving to a new buffer builds the element before the old buffer is let go, since `args` may refer into it
+  template <typename... Args>
+  void EmplaceBack(Args&&... args) {
+    bool full = owns_tail_ && buffer_->Size() == buffer_->Capacity();
+    if (!owns_tail_ || (full && IsShared())) {
+      auto grown = Copy(owns_tail_ ? std::max(size_ + 1, buffer_->Capacity() * 2) : size_ + 1);
+      grown->EmplaceBack(std::forward<Args>(args)...);
+      buffer_ = std::move(grown);
+      owns_tail_ = true;
+    } else {
+      buffer_->EmplaceBack(std::forward<Args>(args)...);
+    }
+    ++size_;
+  }
+
+  void PopBack() {
+    if (size_ == 0) {
+      return;
+    }
+    PrepareWrite();
+    buffer_->PopBack();
+    --size_;
+  }
+
+  void Set(size_t idx, T value) {
+    if (idx >= size_) {
+      throw std::out_of_range("Index overcomes border");
+    }
+    PrepareWrite();
+    (*buffer_)[idx] = std::move(value);
+  }
+
+  void Clear() {
+    if (IsShared() || !owns_tail_) {
+      buffer_.Reset();
+      owns_tail_ = false;
+    } else {
+      buffer_->Clear();
+    }
+    size_ = 0;
+  }
+
+  void Reserve(size_t new_cap) {
+    if (!owns_tail_ || (IsShared() && new_cap > buffer_->Capacity())) {
+      Detach(new_cap);
+      return;
+    }
+    buffer_->Reserve(new_cap);
+  }
+
+  // Runs `edit` on a buffer nobody else sees, for changes the methods above do not cover
+  template <class F>
+  void Update(F&& edit) {
+    PrepareWrite();
+    edit(*buffer_);
+    size_ = buffer_->Size();
+  }
+
+  // Iterators
+  ConstIterator begin() const {  // NOLINT
+    return Data();
+  }
+
+  ConstIterator end() const {  // NOLINT
+    return Data() + size_;
+  }
+
+ private:
+  SharedPtr<Vector<T>> buffer_;
+  size_t size_ = 0;
+  // Only the owner of the tail appends in place; copies and moved-from vectors start without it
+  bool owns_tail_ = false;
+
+  SharedPtr<Vector<T>> Copy(size_t capacity) const {
+    auto copy = MakeShared<Vector<T>>();
+    copy->Reserve(std::max(capacity, size_));
+    if (size_ != 0) {
+      copy->Append(buffer_->Data(), buffer_->Data() + size_);
+    }
+    return copy;
+  }
+
+  void Detach(size_t capacity) {
+    buffer_ = Copy(capacity);
+    owns_tail_ = true;
+  }
+
+  void PrepareWrite() {
+    if (!owns_tail_ || IsShared()) {
+      Detach(size_);
+    }
+  }
+};
+
+#endif  // COW_VECTOR_H_
@@ -0,0 +1,681 @@
+#ifndef FLAT_UNORDERED_SET_H_
+#define FLAT_UNORDERED_SET_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "hash_mix.h"
+
+const float kFlatMaxLoadFactor = 0.875;
+
+// Control bytes: a full slot keeps the low 7 bits of its hash, so the sign bit marks empty/deleted
+const int8_t kCtrlEmpty = -128;
+const int8_t kCtrlDeleted = -2;
+
+const size_t kGroupWidth = 16;
+
+// One bit per slot of a group, walked from the lowest slot up
+class GroupBitMask {
+ public:
+  explicit GroupBitMask(uint32_t mask) : mask_(mask) {
+  }
+
+  explicit operator bool() const {
+    return mask_ != 0;
+  }
+
+  size_t Lowest() const {
+    return __builtin_ctz(mask_);
+  }
+
+  void DropLowest() {
+    mask_ &= mask_ - 1;
+  }
+
+ private:
+  uint32_t mask_;
+};
+
+// Compares the control bytes of kGroupWidth slots at once
+class CtrlGroup {
+ public:
+#ifdef __SSE2__
+  explicit CtrlGroup(const int8_t* ctrl) : ctrl_(_mm_load_si128(reinterpret_cast<const __m128i*>(ctrl))) {
+  }
+
+  GroupBitMask Match(int8_t h2) const {
+    return GroupBitMask(_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl_, _mm_set1_epi8(h2))));
+  }
+
+  GroupBitMask MatchEmpty() const {
+    return Match(kCtrlEmpty);
+  }
+
+  GroupBitMask MatchEmptyOrDeleted() const {
+    return GroupBitMask(_mm_movemask_epi8(ctrl_));
+  }
+
+  GroupBitMask MatchFull() const {
+    return GroupBitMask(_mm_movemask_epi8(ctrl_) ^ 0xFFFF);
+  }
+
+ private:
+  __m128i ctrl_;
+#else
+  // Portable fallback: two 8-byte words with the per-byte results packed into the same bit layout as SSE2
+  explicit CtrlGroup(const int8_t* ctrl) {
+    std::memcpy(words_, ctrl, sizeof(words_));
+  }
+
+  GroupBitMask Match(int8_t h2) const {
+    return GroupBitMask(Pack(MatchZero(words_[0] ^ (kLsbs * static_cast<uint8_t>(h2)))) |
+                        Pack(MatchZero(words_[1] ^ (kLsbs * static_cast<uint8_t>(h2)))) << 8);
+  }
+
+  GroupBitMask MatchEmpty() const {
+    return Match(kCtrlEmpty);
+  }
+
+  GroupBitMask MatchEmptyOrDeleted() const {
+    return GroupBitMask(Pack(words_[0] & kMsbs) | Pack(words_[1] & kMsbs) << 8);
+  }
+
+  GroupBitMask MatchFull() const {
+    return GroupBitMask(Pack(~words_[0] & kMsbs) | Pack(~words_[1] & kMsbs) << 8);
+  }
+
+ private:
+  static constexpr uint64_t kLsbs = 0x0101010101010101ULL;
+  static constexpr uint64_t kMsbs = 0x8080808080808080ULL;
+
+  uint64_t words_[2];
+
+  static uint64_t MatchZero(uint64_t word) {
+    return ~(((word & ~kMsbs) + ~kMsbs) | word | ~kMsbs);
+  }
+
+  static uint32_t Pack(uint64_t msbs) {
+    return static_cast<uint32_t>(((msbs >> 7) * 0x0102040810204080ULL) >> 56);
+  }
+#endif
+};
+
+// Forward iterator over the full slots, in slot order
+template <class KeyT>
+class FlatIterator {
+ public:
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = KeyT;
+  using difference_type = std::ptrdiff_t;
+  using pointer = const KeyT*;
+  using reference = const KeyT&;
+
+  FlatIterator() = default;
+
+  reference operator*() const {
+    return slots_[index_];
+  }
+
+  pointer operator->() const {
+    return slots_ + index_;
+  }
+
+  FlatIterator& operator++() {
+    ++index_;
+    SkipFree();
+    return *this;
+  }
+
+  FlatIterator operator++(int) {
+    FlatIterator copy = *this;
+    ++*this;
+    return copy;
+  }
+
+  bool operator==(const FlatIterator& other) const {
+    return index_ == other.index_;
+  }
+
+  bool operator!=(const FlatIterator& other) const {
+    return !(*this == other);
+  }
+
+ private:
+  template <class, class, class, class>
+  friend class FlatUnorderedSet;
+
+  const int8_t* ctrl_ = nullptr;
+  const KeyT* slots_ = nullptr;
+  size_t index_ = 0;
+  size_t capacity_ = 0;
+
+  FlatIterator(const int8_t* ctrl, const KeyT* slots, size_t index, size_t capacity)
+      : ctrl_(ctrl), slots_(slots), index_(index), capacity_(capacity) {
+    SkipFree();
+  }
+
+  void SkipFree() {
+    while (index_ < capacity_ && ctrl_[index_] < 0) {
+      ++index_;
+    }
+  }
+};
+
+// Owns at most one key extracted from a FlatUnorderedSet; slots cannot be relinked, so the key is moved in and out
+template <class KeyT>
+class FlatNodeHandle {
+ public:
+  FlatNodeHandle() = default;
+
+  bool Empty() const {
+    return !key_.has_value();
+  }
+
+  explicit operator bool() const {
+    return !Empty();
+  }
+
+  KeyT& Value() {
+    return *key_;
+  }
+
+  const KeyT& Value() const {
+    return *key_;
+  }
+
+ private:
+  template <class, class, class, class>
+  friend class FlatUnorderedSet;
+
+  std::optional<KeyT> key_;
+};
+
+// Allocation unit of the table block, so a rebound allocator hands out memory aligned for both groups and keys
+template <size_t Align>
+struct alignas(Align) FlatBlockUnit {
+  unsigned char bytes[Align];
+};
+
+// Open-addressing set: keys live in one contiguous slot array next to a byte of hash metadata per slot,
+// probed kGroupWidth slots at a time
+template <class KeyT, class Hash = SetHash<KeyT>, class KeyEqual = std::equal_to<>,
+          class Allocator = std::allocator<KeyT>>
+class FlatUnorderedSet {
+ public:
+  using NodeHandle = FlatNodeHandle<KeyT>;
+  using ConstIterator = FlatIterator<KeyT>;
+  using Iterator = ConstIterator;
+
+  // Constructors
+  FlatUnorderedSet() = default;
+
+  explicit FlatUnorderedSet(size_t count, const Hash& hash = Hash(), const KeyEqual& equal = KeyEqual(),
+                            const Allocator& alloc = Allocator())
+      : hasher_(hash), key_equal_(equal), alloc_(alloc) {
+    Reserve(count);
+  }
+
+  template <typename It>
+  FlatUnorderedSet(It begin, It end) {
+    InsertRange(begin, end);
+  }
+
+  FlatUnorderedSet(const FlatUnorderedSet& other)
+      : hasher_(other.hasher_), key_equal_(other.key_equal_), alloc_(other.alloc_) {
+    if (other.capacity_ == 0) {
+      return;
+    }
+    Allocate(other.capacity_);
+    size_t i = 0;
+    try {
+      for (; i < capacity_; ++i) {
+        if (IsFull(other.ctrl_[i])) {
+          new (slots_ + i) KeyT(other.slots_[i]);
+        }
+        ctrl_[i] = other.ctrl_[i];
+      }
+    } catch (...) {
+      DestroySlots(i);
+      Deallocate();
+      throw;
+    }
+    n_elements_ = other.n_elements_;
+    n_deleted_ = other.n_deleted_;
+  }
+
+  FlatUnorderedSet(FlatUnorderedSet&& other) noexcept
+      : hasher_(std::move(other.hasher_)),
+        key_equal_(std::move(other.key_equal_)),
+        alloc_(std::move(other.alloc_)),
+        ctrl_(other.ctrl_),
+        slots_(other.slots_),
+        capacity_(other.capacity_),
+        n_elements_(other.n_elements_),
+        n_deleted_(other.n_deleted_) {
+    other.Forget();
+  }
+
+  // Copy/move assigns
+  FlatUnorderedSet& operator=(const FlatUnorderedSet& other) {
+    if (this != &other) {
+      FlatUnorderedSet copy(other);
+      Swap(copy);
+    }
+    return *this;
+  }
+
+  FlatUnorderedSet& operator=(FlatUnorderedSet&& other) noexcept {
+    if (this != &other) {
+      DestroySlots(capacity_);
+      Deallocate();
+      hasher_ = std::move(other.hasher_);
+      key_equal_ = std::move(other.key_equal_);
+      alloc_ = std::move(other.alloc_);
+      ctrl_ = other.ctrl_;
+      slots_ = other.slots_;
+      capacity_ = other.capacity_;
+      n_elements_ = other.n_elements_;
+      n_deleted_ = other.n_deleted_;
+      other.Forget();
+    }
+    return *this;
+  }
+
+  // Destructor
+  ~FlatUnorderedSet() {
+    DestroySlots(capacity_);
+    Deallocate();
+  }
+
+  // Methods
+  size_t Size() const {
+    return n_elements_;
+  }
+
+  bool Empty() const {
+    return n_elements_ == 0;
+  }
+
+  size_t BucketCount() const {
+    return capacity_;
+  }
+
+  size_t BucketSize(const size_t id) const {
+    if (id >= BucketCount()) {
+      return 0;
+    }
+    return IsFull(ctrl_[id]) ? 1 : 0;
+  }
+
+  size_t Bucket(const KeyT& key) const {
+    return BucketOf(key);
+  }
+
+  template <class K, class = EnableIfTransparent<Hash, KeyEqual, K>>
+  size_t Bucket(const K& key) const {
+    return BucketOf(key);
+  }
+
+  double LoadFactor() const {
+    return n_elements_ / std::max(static_cast<double>(capacity_), 1.0);
+  }
+
+  void Clear() {
+    DestroySlots(capacity_);
+    if (ctrl_ != nullptr) {
+      std::memset(ctrl_, kCtrlEmpty, capacity_);
+    }
+    n_elements_ = 0;
+    n_deleted_ = 0;
+  }
+
+  bool Find(const KeyT& key) const {
+    return FindIndex(key, HashOf(key)) != capacity_;
+  }
+
+  template <class K, class = EnableIfTransparent<Hash, KeyEqual, K>>
+  bool Find(const K& key) const {
+    return FindIndex(key, HashOf(key)) != capacity_;
+  }
+
+  bool Insert(const KeyT& key) {
+    return InsertKey(key);
+  }
+
+  bool Insert(KeyT&& key) {
+    return InsertKey(std::move(key));
+  }
+
+  // Returns false and leaves the key in the handle when it is already present
+  bool Insert(NodeHandle&& node) {
+    if (node.Empty() || !InsertKey(std::move(node.Value()))) {
+      return false;
+    }
+    node.key_.reset();
+    return true;
+  }
+
+  template <class... Args>
+  bool Emplace(Args&&... args) {
+    return InsertKey(KeyT(std::forward<Args>(args)...));
+  }
+
+  NodeHandle Extract(const KeyT& key) {
+    return ExtractKey(key);
+  }
+
+  template <class K, class = EnableIfTransparent<Hash, KeyEqual, K>>
+  NodeHandle Extract(const K& key) {
+    return ExtractKey(key);
+  }
+
+  // Moves every key missing here out of other; keys present in both stay in other
+  void Merge(FlatUnorderedSet& other) {
+    if (this == &other) {
+      return;
+    }
+    Reserve(n_elements_ + other.n_elements_);
+    for (size_t i = 0; i < other.capacity_; ++i) {
+      if (IsFull(other.ctrl_[i]) && InsertKey(std::move(other.slots_[i]))) {
+        other.EraseAt(i);
+      }
+    }
+  }
+
+  void Merge(FlatUnorderedSet&& other) {
+    Merge(other);
+  }
+
+  bool Erase(const KeyT& key) {
+    return EraseKey(key);
+  }
+
+  template <class K, class = EnableIfTransparent<Hash, KeyEqual, K>>
+  bool Erase(const K& key) {
+    return EraseKey(key);
+  }
+
+  void Rehash(size_t new_bucket_count) {
+    size_t new_capacity = NormalizeCapacity(std::max(new_bucket_count, MinCapacityFor(n_elements_ + 1)));
+    if (new_capacity == capacity_ && n_deleted_ == 0) {
+      return;
+    }
+    FlatUnorderedSet rebuilt(0, hasher_, key_equal_, alloc_);
+    rebuilt.Allocate(new_capacity);
+    for (size_t i = 0; i < capacity_; ++i) {
+      if (IsFull(ctrl_[i])) {
+        size_t hash = HashOf(slots_[i]);
+        size_t index = rebuilt.FindFreeIndex(hash);
+        new (rebuilt.slots_ + index) KeyT(std::move(slots_[i]));
+        rebuilt.SetFull(index, hash);
+      }
+    }
+    Swap(rebuilt);
+  }
+
+  void Reserve(size_t new_bucket_count) {
+    if (new_bucket_count == 0 || MinCapacityFor(new_bucket_count) <= capacity_) {
+      return;
+    }
+    Rehash(MinCapacityFor(new_bucket_count));
+  }
+
+  // Sizes the table for the whole batch once, then inserts; returns the number of keys that were new
+  template <typename It>
+  size_t InsertRange(It begin, It end) {
+    if constexpr (std::is_base_of_v<std::forward_iterator_tag,
+                                    typename std::iterator_traits<It>::iterator_category>) {
+      Reserve(n_elements_ + std::distance(begin, end));
+    }
+    size_t inserted = 0;
+    for (auto it = begin; it != end; ++it) {
+      inserted += Insert(*it) ? 1 : 0;
+    }
+    return inserted;
+  }
+
+  // Visits every key in slot order, skipping a whole group of free slots per control-byte compare
+  template <class F>
+  void ForEach(F&& visit) const {
+    for (size_t offset = 0; offset < capacity_; offset += kGroupWidth) {
+      for (auto full = CtrlGroup(ctrl_ + offset).MatchFull(); full; full.DropLowest()) {
+        visit(slots_[offset + full.Lowest()]);
+      }
+    }
+  }
+
+  // Iterators
+  ConstIterator begin() const {  // NOLINT
+    return ConstIterator(ctrl_, slots_, 0, capacity_);
+  }
+
+  ConstIterator end() const {  // NOLINT
+    return ConstIterator(ctrl_, slots_, capacity_, capacity_);
+  }
+
+  ConstIterator cbegin() const {  // NOLINT
+    return begin();
+  }
+
+  ConstIterator cend() const {  // NOLINT
+    return end();
+  }
+
+  void Swap(FlatUnorderedSet& other) noexcept {
+    std::swap(hasher_, other.hasher_);
+    std::swap(key_equal_, other.key_equal_);
+    std::swap(alloc_, other.alloc_);
+    std::swap(ctrl_, other.ctrl_);
+    std::swap(slots_, other.slots_);
+    std::swap(capacity_, other.capacity_);
+    std::swap(n_elements_, other.n_elements_);
+    std::swap(n_deleted_, other.n_deleted_);
+  }
+
+ private:
+  using BlockUnit = FlatBlockUnit<std::max(kGroupWidth, alignof(KeyT))>;
+  using BlockAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<BlockUnit>;
+
+  Hash hasher_;
+  KeyEqual key_equal_;
+  Allocator alloc_;
+  int8_t* ctrl_ = nullptr;
+  KeyT* slots_ = nullptr;
+  size_t capacity_ = 0;
+  size_t n_elements_ = 0;
+  size_t n_deleted_ = 0;
+
+  static bool IsFull(int8_t ctrl) {
+    return ctrl >= 0;
+  }
+
+  template <class K>
+  size_t HashOf(const K& key) const {
+    return MixHash(hasher_(key));
+  }
+
+  static size_t H1(size_t hash) {
+    return hash >> 7;
+  }
+
+  static int8_t H2(size_t hash) {
+    return static_cast<int8_t>(hash & 0x7F);
+  }
+
+  static size_t NormalizeCapacity(size_t count) {
+    size_t capacity = kGroupWidth;
+    while (capacity < count) {
+      capacity <<= 1;
+    }
+    return capacity;
+  }
+
+  static size_t MinCapacityFor(size_t n_elements) {
+    return NormalizeCapacity(static_cast<size_t>(n_elements / static_cast<double>(kFlatMaxLoadFactor)) + 1);
+  }
+
+  // Groups are visited in triangular order, which covers every group of a power-of-two table
+  template <class K>
+  size_t FindIndex(const K& key, size_t hash) const {
+    if (capacity_ == 0) {
+      return capacity_;
+    }
+    size_t group_mask = capacity_ / kGroupWidth - 1;
+    int8_t h2 = H2(hash);
+    size_t group = H1(hash) & group_mask;
+    for (size_t step = 1; step <= group_mask + 1; ++step) {
+      size_t offset = group * kGroupWidth;
+      CtrlGroup ctrl(ctrl_ + offset);
+      for (auto match = ctrl.Match(h2); match; match.DropLowest()) {
+        size_t index = offset + match.Lowest();
+        if (key_equal_(slots_[index], key)) {
+          return index;
+        }
+      }
+      if (ctrl.MatchEmpty()) {
+        return capacity_;
+      }
+      group = (group + step) & group_mask;
+    }
+    return capacity_;
+  }
+
+  size_t FindFreeIndex(size_t hash) const {
+    size_t group_mask = capacity_ / kGroupWidth - 1;
+    size_t group = H1(hash) & group_mask;
+    for (size_t step = 1;; ++step) {
+      auto free = CtrlGroup(ctrl_ + group * kGroupWidth).MatchEmptyOrDeleted();
+      if (free) {
+        return group * kGroupWidth + free.Lowest();
+      }
+      group = (group + step) & group_mask;
+    }
+  }
+
+  template <class K>
+  bool InsertKey(K&& key) {
+    size_t hash = HashOf(key);
+    if (FindIndex(key, hash) != capacity_) {
+      return false;
+    }
+    PrepareInsert();
+    size_t index = FindFreeIndex(hash);
+    new (slots_ + index) KeyT(std::forward<K>(key));
+    SetFull(index, hash);
+    return true;
+  }
+
+  template <class K>
+  bool EraseKey(const K& key) {
+    size_t index = FindIndex(key, HashOf(key));
+    if (index == capacity_) {
+      return false;
+    }
+    EraseAt(index);
+    return true;
+  }
+
+  template <class K>
+  NodeHandle ExtractKey(const K& key) {
+    NodeHandle handle;
+    size_t index = FindIndex(key, HashOf(key));
+    if (index != capacity_) {
+      handle.key_.emplace(std::move(slots_[index]));
+      EraseAt(index);
+    }
+    return handle;
+  }
+
+  void EraseAt(size_t index) {
+    std::destroy_at(slots_ + index);
+    --n_elements_;
+    // A group that still has an empty slot never overflowed, so no probe sequence runs through it
+    if (CtrlGroup(ctrl_ + (index & ~(kGroupWidth - 1))).MatchEmpty()) {
+      ctrl_[index] = kCtrlEmpty;
+    } else {
+      ctrl_[index] = kCtrlDeleted;
+      ++n_deleted_;
+    }
+  }
+
+  template <class K>
+  size_t BucketOf(const K& key) const {
+    return capacity_ != 0 ? H1(HashOf(key)) & (capacity_ - 1) : 0;
+  }
+
+  void PrepareInsert() {
+    if ((n_elements_ + n_deleted_ + 1) > capacity_ * kFlatMaxLoadFactor) {
+      // Tombstone-heavy tables are cleaned in place instead of doubling
+      Rehash(n_deleted_ > n_elements_ ? capacity_ : capacity_ * 2);
+    }
+  }
+
+  void SetFull(size_t index, size_t hash) {
+    if (ctrl_[index] == kCtrlDeleted) {
+      --n_deleted_;
+    }
+    ctrl_[index] = H2(hash);
+    ++n_elements_;
+  }
+
+  // Control bytes come first so every group load is aligned; slots follow in the same block
+  static size_t SlotsOffset(size_t capacity) {
+    return (capacity + alignof(KeyT) - 1) / alignof(KeyT) * alignof(KeyT);
+  }
+
+  static size_t BlockUnits(size_t capacity) {
+    return (SlotsOffset(capacity) + capacity * sizeof(KeyT) + sizeof(BlockUnit) - 1) / sizeof(BlockUnit);
+  }
+
+  void Allocate(size_t capacity) {
+    BlockAllocator block_alloc(alloc_);
+    BlockUnit* block = std::allocator_traits<BlockAllocator>::allocate(block_alloc, BlockUnits(capacity));
+    auto void_ptr = static_cast<void*>(block);
+    ctrl_ = static_cast<int8_t*>(void_ptr);
+    slots_ = reinterpret_cast<KeyT*>(static_cast<char*>(void_ptr) + SlotsOffset(capacity));
+    std::memset(ctrl_, kCtrlEmpty, capacity);
+    capacity_ = capacity;
+  }
+
+  void Deallocate() {
+    if (ctrl_ == nullptr) {
+      return;
+    }
+    BlockAllocator block_alloc(alloc_);
+    std::allocator_traits<BlockAllocator>::deallocate(block_alloc, reinterpret_cast<BlockUnit*>(ctrl_),
+                                                      BlockUnits(capacity_));
+    Forget();
+  }
+
+  void DestroySlots(size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+      if (IsFull(ctrl_[i])) {
+        std::destroy_at(slots_ + i);
+      }
+    }
+  }
+
+  void Forget() {
+    ctrl_ = nullptr;
+    slots_ = nullptr;
+    capacity_ = 0;
+    n_elements_ = 0;
+    n_deleted_ = 0;
+  }
+};
+
+#endif  // FLAT_UNORDERED_SET_H_
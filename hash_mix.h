@@ -0,0 +1,50 @@
+#ifndef HASH_MIX_H_
+#define HASH_MIX_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// Murmur3 finalizer (fmix64): std::hash is the identity for integers, so spread the bits before masking them.
+// Every input bit affects every output bit, so the probe position and FlatUnorderedSet's 7-bit control tags are
+// both well mixed
+inline size_t MixHash(size_t hash) {
+  uint64_t mixed = hash;
+  mixed ^= mixed >> 33;
+  mixed *= 0xff51afd7ed558ccdULL;
+  mixed ^= mixed >> 33;
+  mixed *= 0xc4ceb9fe1a85ec53ULL;
+  mixed ^= mixed >> 33;
+  return static_cast<size_t>(mixed);
+}
+
+// Default set hasher. The std::string one is transparent: string_view and C string probes hash exactly like the
+// equal std::string, so lookups need no temporary key
+template <class KeyT>
+struct SetHash : std::hash<KeyT> {};
+
+template <>
+struct SetHash<std::string> {
+  using is_transparent = void;
+
+  size_t operator()(std::string_view str) const {
+    return std::hash<std::string_view>{}(str);
+  }
+};
+
+template <class Hash, class KeyEqual, class = void>
+struct IsTransparentLookup : std::false_type {};
+
+template <class Hash, class KeyEqual>
+struct IsTransparentLookup<Hash, KeyEqual,
+                           std::void_t<typename Hash::is_transparent, typename KeyEqual::is_transparent>>
+    : std::true_type {};
+
+// Enables lookups by a probe type K only when both the hasher and the equality are transparent
+template <class Hash, class KeyEqual, class K>
+using EnableIfTransparent = std::enable_if_t<IsTransparentLookup<Hash, KeyEqual>::value, K>;
+
+#endif  // HASH_MIX_H_
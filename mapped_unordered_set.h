@@ -0,0 +1,319 @@
+#ifndef MAPPED_UNORDERED_SET_H_
+#define MAPPED_UNORDERED_SET_H_
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "flat_unordered_set.h"
+#include "hash_mix.h"
+#include "unordered_set.h"
+
+// Snapshot file layout, native byte order:
+//   [0, 64)                  SnapshotHeader
+//   [64, 64 + capacity)      control bytes, same encoding and group probing as FlatUnorderedSet
+//   [slots offset, ...)      capacity key slots, the offset rounded up to kSnapshotAlignment
+// A file written on a machine of the other byte order fails the magic check
+const uint64_t kSnapshotMagic = 0x31504E5354455355ULL;  // "USETSNP1"
+const uint32_t kSnapshotVersion = 2;  // 2: SnapshotHash mixes with the full fmix64
+const uint64_t kDefaultSnapshotSeed = 0x9E3779B97F4A7C15ULL;
+const size_t kSnapshotAlignment = 64;
+
+class SnapshotError : public std::runtime_error {
+ public:
+  explicit SnapshotError(const std::string& what) : std::runtime_error("SnapshotError: " + what) {
+  }
+};
+
+struct SnapshotHeader {
+  uint64_t magic;
+  uint32_t version;
+  uint32_t key_size;
+  uint64_t seed;
+  uint64_t capacity;
+  uint64_t size;
+};
+
+// Seeded hash of the key bytes. Unlike std::hash it is fixed by this format, so a file probes the same way in
+// every process and build that maps it
+inline uint64_t SnapshotHash(const void* data, size_t size, uint64_t seed) {
+  const auto* bytes = static_cast<const unsigned char*>(data);
+  uint64_t hash = seed ^ (size * 0xff51afd7ed558ccdULL);
+  for (; size >= sizeof(uint64_t); size -= sizeof(uint64_t), bytes += sizeof(uint64_t)) {
+    uint64_t word;
+    std::memcpy(&word, bytes, sizeof(word));
+    hash = (hash ^ MixHash(word)) * 0x9E3779B97F4A7C15ULL;
+  }
+  if (size > 0) {
+    uint64_t word = 0;
+    std::memcpy(&word, bytes, size);
+    hash = (hash ^ MixHash(word)) * 0x9E3779B97F4A7C15ULL;
+  }
+  return MixHash(hash);
+}
+
+// Owns one mmap of a whole file: read-only for an existing file, or read-write for a new file of a given size
+class MappedFile {
+ public:
+  // Constructors
+  MappedFile() = default;
+
+  explicit MappedFile(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      throw SnapshotError("cannot open " + path + ": " + std::strerror(errno));
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size == 0) {
+      ::close(fd);
+      throw SnapshotError("cannot map " + path);
+    }
+    Map(fd, static_cast<size_t>(st.st_size), PROT_READ, path);
+  }
+
+  MappedFile(const std::string& path, size_t size) {
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+      throw SnapshotError("cannot create " + path + ": " + std::strerror(errno));
+    }
+    if (::ftruncate(fd, static_cast<off_t>(size)) != 0) {
+      ::close(fd);
+      throw SnapshotError("cannot resize " + path + ": " + std::strerror(errno));
+    }
+    Map(fd, size, PROT_READ | PROT_WRITE, path);
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  MappedFile(MappedFile&& other) noexcept
+      : data_(std::exchange(other.data_, nullptr)), size_(std::exchange(other.size_, 0)) {
+  }
+
+  MappedFile& operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+      Unmap();
+      data_ = std::exchange(other.data_, nullptr);
+      size_ = std::exchange(other.size_, 0);
+    }
+    return *this;
+  }
+
+  ~MappedFile() {
+    Unmap();
+  }
+
+  // Methods
+  unsigned char* Data() const {
+    return static_cast<unsigned char*>(data_);
+  }
+
+  size_t Size() const {
+    return size_;
+  }
+
+  void Sync() const {
+    if (::msync(data_, size_, MS_SYNC) != 0) {
+      throw SnapshotError(std::string("msync failed: ") + std::strerror(errno));
+    }
+  }
+
+ private:
+  void* data_ = nullptr;
+  size_t size_ = 0;
+
+  // The mapping keeps the file alive, so the descriptor is closed right away
+  void Map(int fd, size_t size, int prot, const std::string& path) {
+    void* data = ::mmap(nullptr, size, prot, MAP_SHARED, fd, 0);
+    int error = errno;
+    ::close(fd);
+    if (data == MAP_FAILED) {
+      throw SnapshotError("cannot map " + path + ": " + std::strerror(error));
+    }
+    data_ = data;
+    size_ = size;
+  }
+
+  void Unmap() {
+    if (data_ != nullptr) {
+      ::munmap(data_, size_);
+    }
+  }
+};
+
+template <class KeyT>
+struct SnapshotLayout {
+  static_assert(std::is_trivially_copyable_v<KeyT> && std::has_unique_object_representations_v<KeyT>,
+                "snapshot keys are stored, hashed and compared as raw bytes");
+
+  static constexpr size_t kCtrlOffset = kSnapshotAlignment;
+
+  static size_t CapacityFor(size_t size) {
+    size_t capacity = kGroupWidth;
+    while (size + 1 > capacity * kFlatMaxLoadFactor) {
+      capacity <<= 1;
+    }
+    return capacity;
+  }
+
+  static size_t SlotsOffset(size_t capacity) {
+    return (kCtrlOffset + capacity + kSnapshotAlignment - 1) / kSnapshotAlignment * kSnapshotAlignment;
+  }
+
+  static size_t FileSize(size_t capacity) {
+    return SlotsOffset(capacity) + capacity * sizeof(KeyT);
+  }
+};
+
+// Builds the snapshot in a mapped temporary file next to `path` and renames it into place once synced, so readers
+// never observe a half-written file
+template <class KeyT, class ForEachKey>
+void WriteSnapshotKeys(size_t size, ForEachKey&& for_each_key, const std::string& path, uint64_t seed) {
+  using Layout = SnapshotLayout<KeyT>;
+  size_t capacity = Layout::CapacityFor(size);
+  std::string tmp_path = path + ".tmp";
+  try {
+    MappedFile file(tmp_path, Layout::FileSize(capacity));
+    auto* ctrl = reinterpret_cast<int8_t*>(file.Data() + Layout::kCtrlOffset);
+    unsigned char* slots = file.Data() + Layout::SlotsOffset(capacity);
+    std::memset(ctrl, static_cast<unsigned char>(kCtrlEmpty), capacity);
+    size_t group_mask = capacity / kGroupWidth - 1;
+    size_t written = 0;
+    for_each_key([&](const KeyT& key) {
+      if (written == size) {
+        throw SnapshotError("set grew while it was being written");
+      }
+      uint64_t hash = SnapshotHash(&key, sizeof(KeyT), seed);
+      size_t group = (hash >> 7) & group_mask;
+      for (size_t step = 1;; ++step) {
+        auto empty = CtrlGroup(ctrl + group * kGroupWidth).MatchEmpty();
+        if (empty) {
+          size_t index = group * kGroupWidth + empty.Lowest();
+          ctrl[index] = static_cast<int8_t>(hash & 0x7F);
+          std::memcpy(slots + index * sizeof(KeyT), &key, sizeof(KeyT));
+          break;
+        }
+        group = (group + step) & group_mask;
+      }
+      ++written;
+    });
+    // The header goes in last: a file without a valid magic is never mistaken for a snapshot
+    SnapshotHeader header{kSnapshotMagic, kSnapshotVersion, sizeof(KeyT), seed, capacity, written};
+    std::memcpy(file.Data(), &header, sizeof(header));
+    file.Sync();
+  } catch (...) {
+    ::unlink(tmp_path.c_str());
+    throw;
+  }
+  if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+    throw SnapshotError("cannot rename " + tmp_path + ": " + std::strerror(errno));
+  }
+}
+
+template <class KeyT, class Hash, class KeyEqual, class Allocator, class Policy>
+void WriteSnapshot(const UnorderedSet<KeyT, Hash, KeyEqual, Allocator, Policy>& set, const std::string& path,
+                   uint64_t seed = kDefaultSnapshotSeed) {
+  WriteSnapshotKeys<KeyT>(set.Size(), [&set](auto&& visit) { set.ForEach(visit); }, path, seed);
+}
+
+template <class KeyT, class Hash, class KeyEqual, class Allocator>
+void WriteSnapshot(const FlatUnorderedSet<KeyT, Hash, KeyEqual, Allocator>& set, const std::string& path,
+                   uint64_t seed = kDefaultSnapshotSeed) {
+  WriteSnapshotKeys<KeyT>(set.Size(), [&set](auto&& visit) { set.ForEach(visit); }, path, seed);
+}
+
+// Read-only set served straight from a mapped snapshot: opening validates the header and Find probes the mapped
+// control bytes and slots in place, so nothing is deserialized or copied
+template <class KeyT>
+class MappedUnorderedSet {
+ public:
+  // Constructors
+  explicit MappedUnorderedSet(const std::string& path) : file_(path) {
+    using Layout = SnapshotLayout<KeyT>;
+    if (file_.Size() < sizeof(SnapshotHeader)) {
+      throw SnapshotError(path + " is too short");
+    }
+    std::memcpy(&header_, file_.Data(), sizeof(header_));
+    if (header_.magic != kSnapshotMagic) {
+      throw SnapshotError(path + " is not a snapshot");
+    }
+    if (header_.version != kSnapshotVersion) {
+      throw SnapshotError(path + " has unsupported version " + std::to_string(header_.version));
+    }
+    if (header_.key_size != sizeof(KeyT)) {
+      throw SnapshotError(path + " holds keys of " + std::to_string(header_.key_size) + " bytes");
+    }
+    size_t capacity = header_.capacity;
+    if (capacity < kGroupWidth || (capacity & (capacity - 1)) != 0 || header_.size >= capacity ||
+        file_.Size() != Layout::FileSize(capacity)) {
+      throw SnapshotError(path + " is corrupted");
+    }
+    ctrl_ = reinterpret_cast<const int8_t*>(file_.Data() + Layout::kCtrlOffset);
+    slots_ = reinterpret_cast<const KeyT*>(file_.Data() + Layout::SlotsOffset(capacity));
+  }
+
+  // Methods
+  size_t Size() const {
+    return header_.size;
+  }
+
+  bool Empty() const {
+    return header_.size == 0;
+  }
+
+  size_t BucketCount() const {
+    return header_.capacity;
+  }
+
+  uint64_t Seed() const {
+    return header_.seed;
+  }
+
+  bool Find(const KeyT& key) const {
+    uint64_t hash = SnapshotHash(&key, sizeof(KeyT), header_.seed);
+    size_t group_mask = header_.capacity / kGroupWidth - 1;
+    auto h2 = static_cast<int8_t>(hash & 0x7F);
+    size_t group = (hash >> 7) & group_mask;
+    for (size_t step = 1; step <= group_mask + 1; ++step) {
+      size_t offset = group * kGroupWidth;
+      CtrlGroup ctrl(ctrl_ + offset);
+      for (auto match = ctrl.Match(h2); match; match.DropLowest()) {
+        if (std::memcmp(slots_ + offset + match.Lowest(), &key, sizeof(KeyT)) == 0) {
+          return true;
+        }
+      }
+      if (ctrl.MatchEmpty()) {
+        return false;
+      }
+      group = (group + step) & group_mask;
+    }
+    return false;
+  }
+
+  template <class F>
+  void ForEach(F&& visit) const {
+    for (size_t offset = 0; offset < header_.capacity; offset += kGroupWidth) {
+      for (auto full = CtrlGroup(ctrl_ + offset).MatchFull(); full; full.DropLowest()) {
+        visit(slots_[offset + full.Lowest()]);
+      }
+    }
+  }
+
+ private:
+  MappedFile file_;
+  SnapshotHeader header_;
+  const int8_t* ctrl_ = nullptr;
+  const KeyT* slots_ = nullptr;
+};
+
+#endif  // MAPPED_UNORDERED_SET_H_
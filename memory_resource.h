@@ -0,0 +1,260 @@
+#ifndef MEMORY_RESOURCE_H_
+#define MEMORY_RESOURCE_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+// Source of raw memory behind PolymorphicAllocator. None of the resources below are thread-safe: each is meant to
+// be owned by one request or one thread
+class MemoryResource {
+ public:
+  virtual ~MemoryResource() = default;
+
+  virtual void* Allocate(size_t bytes, size_t align) = 0;
+  virtual void Deallocate(void* ptr, size_t bytes, size_t align) = 0;
+
+  virtual bool IsEqual(const MemoryResource& other) const {
+    return this == &other;
+  }
+};
+
+class NewDeleteResource : public MemoryResource {
+ public:
+  void* Allocate(size_t bytes, size_t align) override {
+    return ::operator new(bytes, static_cast<std::align_val_t>(align));
+  }
+
+  void Deallocate(void* ptr, size_t bytes, size_t align) override {
+    ::operator delete(ptr, bytes, static_cast<std::align_val_t>(align));
+  }
+
+  bool IsEqual(const MemoryResource& other) const override {
+    return dynamic_cast<const NewDeleteResource*>(&other) != nullptr;
+  }
+};
+
+inline MemoryResource* DefaultResource() {
+  static NewDeleteResource resource;
+  return &resource;
+}
+
+// Bump allocator: Allocate moves a pointer through chunks taken from the upstream resource, Deallocate is a no-op
+// and Reset hands everything back at once. Chunks grow geometrically, so a request that needs M bytes costs
+// O(log M) upstream calls
+class MonotonicArena : public MemoryResource {
+ public:
+  // Constructors
+  explicit MonotonicArena(size_t initial_size = kInitialChunk, MemoryResource* upstream = DefaultResource())
+      : upstream_(upstream), next_chunk_size_(std::max(initial_size, sizeof(Chunk) + kMaxAlign)) {
+  }
+
+  MonotonicArena(const MonotonicArena&) = delete;
+  MonotonicArena& operator=(const MonotonicArena&) = delete;
+
+  ~MonotonicArena() override {
+    Release();
+  }
+
+  // Methods
+  void* Allocate(size_t bytes, size_t align) override {
+    auto current = reinterpret_cast<uintptr_t>(cursor_);
+    uintptr_t aligned = (current + align - 1) & ~(uintptr_t{align} - 1);
+    if (cursor_ == nullptr || aligned + bytes > reinterpret_cast<uintptr_t>(end_)) {
+      NewChunk(bytes + align);
+      current = reinterpret_cast<uintptr_t>(cursor_);
+      aligned = (current + align - 1) & ~(uintptr_t{align} - 1);
+    }
+    cursor_ = reinterpret_cast<char*>(aligned + bytes);
+    return reinterpret_cast<void*>(aligned);
+  }
+
+  void Deallocate(void*, size_t, size_t) override {
+  }
+
+  // Frees every chunk but the most recent one, which is kept to serve the next round of allocations
+  void Reset() {
+    if (chunks_ == nullptr) {
+      return;
+    }
+    Chunk* last = chunks_;
+    chunks_ = chunks_->next;
+    Release();
+    last->next = nullptr;
+    chunks_ = last;
+    cursor_ = reinterpret_cast<char*>(last + 1);
+    end_ = reinterpret_cast<char*>(last) + last->size;
+  }
+
+ private:
+  static constexpr size_t kInitialChunk = 4096;
+  static constexpr size_t kMaxAlign = alignof(std::max_align_t);
+
+  struct alignas(std::max_align_t) Chunk {
+    Chunk* next;
+    size_t size;
+  };
+
+  MemoryResource* upstream_;
+  size_t next_chunk_size_;
+  Chunk* chunks_ = nullptr;
+  char* cursor_ = nullptr;
+  char* end_ = nullptr;
+
+  void NewChunk(size_t min_bytes) {
+    size_t size = std::max(next_chunk_size_, sizeof(Chunk) + min_bytes);
+    auto* chunk = static_cast<Chunk*>(upstream_->Allocate(size, kMaxAlign));
+    chunk->next = chunks_;
+    chunk->size = size;
+    chunks_ = chunk;
+    cursor_ = reinterpret_cast<char*>(chunk + 1);
+    end_ = reinterpret_cast<char*>(chunk) + size;
+    next_chunk_size_ = size * 2;
+  }
+
+  void Release() {
+    while (chunks_ != nullptr) {
+      Chunk* next = chunks_->next;
+      upstream_->Deallocate(chunks_, chunks_->size, kMaxAlign);
+      chunks_ = next;
+    }
+    cursor_ = nullptr;
+    end_ = nullptr;
+  }
+};
+
+// Size-class pool: blocks of 16, 32, ..., kMaxPooledSize bytes are carved from upstream chunks and recycled through
+// one free list per class; larger or over-aligned requests go straight to the upstream resource
+class PoolResource : public MemoryResource {
+ public:
+  // Constructors
+  explicit PoolResource(MemoryResource* upstream = DefaultResource()) : upstream_(upstream) {
+  }
+
+  PoolResource(const PoolResource&) = delete;
+  PoolResource& operator=(const PoolResource&) = delete;
+
+  ~PoolResource() override {
+    while (chunks_ != nullptr) {
+      Chunk* next = chunks_->next;
+      upstream_->Deallocate(chunks_, kChunkSize, kMinBlock);
+      chunks_ = next;
+    }
+  }
+
+  // Methods
+  void* Allocate(size_t bytes, size_t align) override {
+    if (bytes > kMaxPooledSize || align > kMinBlock) {
+      return upstream_->Allocate(bytes, align);
+    }
+    size_t cls = ClassOf(bytes);
+    if (free_[cls] == nullptr) {
+      Refill(cls);
+    }
+    Block* block = free_[cls];
+    free_[cls] = block->next;
+    return block;
+  }
+
+  void Deallocate(void* ptr, size_t bytes, size_t align) override {
+    if (bytes > kMaxPooledSize || align > kMinBlock) {
+      upstream_->Deallocate(ptr, bytes, align);
+      return;
+    }
+    size_t cls = ClassOf(bytes);
+    auto* block = static_cast<Block*>(ptr);
+    block->next = free_[cls];
+    free_[cls] = block;
+  }
+
+ private:
+  static constexpr size_t kMinBlock = 16;
+  static constexpr size_t kClassCount = 9;
+  static constexpr size_t kMaxPooledSize = kMinBlock << (kClassCount - 1);
+  static constexpr size_t kChunkSize = 64 * 1024;
+
+  struct Block {
+    Block* next;
+  };
+
+  struct alignas(kMinBlock) Chunk {
+    Chunk* next;
+  };
+
+  MemoryResource* upstream_;
+  Block* free_[kClassCount] = {};
+  Chunk* chunks_ = nullptr;
+
+  static size_t ClassOf(size_t bytes) {
+    size_t cls = 0;
+    while ((kMinBlock << cls) < bytes) {
+      ++cls;
+    }
+    return cls;
+  }
+
+  void Refill(size_t cls) {
+    auto* chunk = static_cast<Chunk*>(upstream_->Allocate(kChunkSize, kMinBlock));
+    chunk->next = chunks_;
+    chunks_ = chunk;
+    size_t block_size = kMinBlock << cls;
+    char* begin = reinterpret_cast<char*>(chunk + 1);
+    char* end = reinterpret_cast<char*>(chunk) + kChunkSize;
+    for (char* ptr = begin; ptr + block_size <= end; ptr += block_size) {
+      auto* block = reinterpret_cast<Block*>(ptr);
+      block->next = free_[cls];
+      free_[cls] = block;
+    }
+  }
+};
+
+// Allocator that forwards to a MemoryResource chosen at run time, so containers with different resources share
+// one type. Like std::pmr, a copy-constructed container goes back to the default resource, and move assignment
+// between containers on different resources moves elements instead of storage
+template <class T>
+class PolymorphicAllocator {
+ public:
+  using value_type = T;
+
+  PolymorphicAllocator() noexcept : resource_(DefaultResource()) {
+  }
+
+  PolymorphicAllocator(MemoryResource* resource) noexcept : resource_(resource) {  // NOLINT
+  }
+
+  template <class U>
+  PolymorphicAllocator(const PolymorphicAllocator<U>& other) noexcept : resource_(other.Resource()) {  // NOLINT
+  }
+
+  T* allocate(size_t n) {  // NOLINT
+    return static_cast<T*>(resource_->Allocate(n * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T* ptr, size_t n) {  // NOLINT
+    resource_->Deallocate(ptr, n * sizeof(T), alignof(T));
+  }
+
+  PolymorphicAllocator select_on_container_copy_construction() const {  // NOLINT
+    return PolymorphicAllocator();
+  }
+
+  MemoryResource* Resource() const {
+    return resource_;
+  }
+
+  template <class U>
+  friend bool operator==(const PolymorphicAllocator& left, const PolymorphicAllocator<U>& right) {
+    return left.Resource() == right.Resource() || left.Resource()->IsEqual(*right.Resource());
+  }
+
+  template <class U>
+  friend bool operator!=(const PolymorphicAllocator& left, const PolymorphicAllocator<U>& right) {
+    return !(left == right);
+  }
+
+ private:
+  MemoryResource* resource_;
+};
+
+#endif  // MEMORY_RESOURCE_H_
@@ -0,0 +1,108 @@
+#ifndef MMAP_ALLOCATOR_H_
+#define MMAP_ALLOCATOR_H_
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <type_traits>
+
+// Buffers from this size up are whole anonymous mappings; smaller ones come from operator new
+const size_t kMmapThreshold = size_t{1} << 20;
+const size_t kHugePageSize = size_t{2} << 20;
+
+// Allocator for large buffers of trivially relocatable elements. Besides allocate/deallocate it offers
+// reallocate(), which Vector uses to grow in place: a mapping is resized with mremap, so the kernel moves page
+// table entries instead of copying the elements, and the old and new buffers never coexist in memory.
+// With HugePages the mappings are 2 MB aligned in size and advised with MADV_HUGEPAGE
+template <class T, bool HugePages = false>
+class MmapAllocator {
+ public:
+  using value_type = T;
+  using is_always_equal = std::true_type;
+
+  template <class U>
+  struct rebind {  // NOLINT
+    using other = MmapAllocator<U, HugePages>;
+  };
+
+  MmapAllocator() noexcept = default;
+
+  template <class U>
+  MmapAllocator(const MmapAllocator<U, HugePages>&) noexcept {  // NOLINT
+  }
+
+  T* allocate(size_t n) {  // NOLINT
+    size_t bytes = n * sizeof(T);
+    if (!IsMapped(bytes)) {
+      return static_cast<T*>(::operator new(bytes, static_cast<std::align_val_t>(alignof(T))));
+    }
+    void* ptr = ::mmap(nullptr, MappedSize(bytes), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED) {
+      throw std::bad_alloc();
+    }
+    Advise(ptr, MappedSize(bytes));
+    return static_cast<T*>(ptr);
+  }
+
+  void deallocate(T* ptr, size_t n) {  // NOLINT
+    size_t bytes = n * sizeof(T);
+    if (!IsMapped(bytes)) {
+      ::operator delete(ptr, static_cast<std::align_val_t>(alignof(T)));
+      return;
+    }
+    ::munmap(ptr, MappedSize(bytes));
+  }
+
+  // Returns a buffer of new_n elements holding the bytes of the first min(old_n, new_n) old ones; `ptr` is no
+  // longer valid afterwards. On failure throws std::bad_alloc and leaves `ptr` untouched
+  T* reallocate(T* ptr, size_t old_n, size_t new_n) {  // NOLINT
+    size_t old_bytes = old_n * sizeof(T);
+    size_t new_bytes = new_n * sizeof(T);
+#ifdef MREMAP_MAYMOVE
+    if (IsMapped(old_bytes) && IsMapped(new_bytes)) {
+      void* moved = ::mremap(ptr, MappedSize(old_bytes), MappedSize(new_bytes), MREMAP_MAYMOVE);
+      if (moved == MAP_FAILED) {
+        throw std::bad_alloc();
+      }
+      Advise(moved, MappedSize(new_bytes));
+      return static_cast<T*>(moved);
+    }
+#endif
+    T* fresh = allocate(new_n);
+    size_t kept = old_bytes < new_bytes ? old_bytes : new_bytes;
+    std::memcpy(static_cast<void*>(fresh), static_cast<const void*>(ptr), kept);
+    deallocate(ptr, old_n);
+    return fresh;
+  }
+
+  friend bool operator==(const MmapAllocator&, const MmapAllocator&) {
+    return true;
+  }
+
+  friend bool operator!=(const MmapAllocator&, const MmapAllocator&) {
+    return false;
+  }
+
+ private:
+  static bool IsMapped(size_t bytes) {
+    return bytes >= kMmapThreshold;
+  }
+
+  static size_t MappedSize(size_t bytes) {
+    size_t unit = HugePages ? kHugePageSize : static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    return (bytes + unit - 1) / unit * unit;
+  }
+
+  static void Advise([[maybe_unused]] void* ptr, [[maybe_unused]] size_t size) {
+#ifdef MADV_HUGEPAGE
+    if constexpr (HugePages) {
+      ::madvise(ptr, size, MADV_HUGEPAGE);
+    }
+#endif
+  }
+};
+
+#endif  // MMAP_ALLOCATOR_H_
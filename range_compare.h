@@ -0,0 +1,75 @@
+#ifndef RANGE_COMPARE_H_
+#define RANGE_COMPARE_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+// Comparison kernels scan this many bytes per step before looking at single elements
+const size_t kCompareBlockBytes = 256;
+
+// Built-in == of these types is byte equality; class types may define == otherwise, so they never qualify
+template <class T>
+constexpr bool kBytewiseEqual = std::is_scalar_v<T> && std::has_unique_object_representations_v<T>;
+
+// Index of the first i with left[i] != right[i], or n. Integers, enums and pointers are compared with memcmp
+// a block at a time; other arithmetic types (floating point) OR the per-element results of a block
+// together, a branch-free loop the compiler vectorizes
+template <class T>
+size_t MismatchIndex(const T* left, const T* right, size_t n) {
+  constexpr size_t kBlock = std::max(kCompareBlockBytes / sizeof(T), size_t{1});
+  size_t i = 0;
+  if constexpr (kBytewiseEqual<T>) {
+    while (i + kBlock <= n && std::memcmp(left + i, right + i, kBlock * sizeof(T)) == 0) {
+      i += kBlock;
+    }
+  } else if constexpr (std::is_arithmetic_v<T>) {
+    for (; i + kBlock <= n; i += kBlock) {
+      bool differ = false;
+      for (size_t j = 0; j < kBlock; ++j) {
+        differ |= left[i + j] != right[i + j];
+      }
+      if (differ) {
+        break;
+      }
+    }
+  }
+  while (i < n && !(left[i] != right[i])) {
+    ++i;
+  }
+  return i;
+}
+
+template <class T>
+bool RangeEqual(const T* left, const T* right, size_t n) {
+  if constexpr (kBytewiseEqual<T>) {
+    return n == 0 || std::memcmp(left, right, n * sizeof(T)) == 0;
+  } else {
+    return MismatchIndex(left, right, n) == n;
+  }
+}
+
+// Same result as std::lexicographical_compare. For arithmetic types the kernel skips the equal prefix; elements
+// that differ but are unordered (NaN) are stepped over just as lexicographical_compare does
+template <class T>
+bool RangeLess(const T* left, size_t left_size, const T* right, size_t right_size) {
+  size_t n = std::min(left_size, right_size);
+  if constexpr (std::is_arithmetic_v<T>) {
+    for (size_t i = MismatchIndex(left, right, n); i < n;) {
+      if (left[i] < right[i]) {
+        return true;
+      }
+      if (right[i] < left[i]) {
+        return false;
+      }
+      ++i;
+      i += MismatchIndex(left + i, right + i, n - i);
+    }
+    return left_size < right_size;
+  } else {
+    return std::lexicographical_compare(left, left + left_size, right, right + right_size);
+  }
+}
+
+#endif  // RANGE_COMPARE_H_
@@ -0,0 +1,413 @@
+#ifndef SEGMENTED_VECTOR_H_
+#define SEGMENTED_VECTOR_H_
+
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "vector.h"
+
+// Default chunk length: as many elements as fit in 16 KB, rounded down to a power of two
+template <class T>
+constexpr size_t DefaultChunkSize() {
+  size_t size = 1;
+  while (size * 2 * sizeof(T) <= (size_t{16} << 10)) {
+    size *= 2;
+  }
+  return size;
+}
+
+// Random access iterator of a SegmentedVector; it stores an index, so it survives appends to the container
+template <class Container, class ValueT>
+class SegmentedIterator {
+ public:
+  using iterator_category = std::random_access_iterator_tag;
+  using value_type = std::remove_const_t<ValueT>;
+  using difference_type = std::ptrdiff_t;
+  using pointer = ValueT*;
+  using reference = ValueT&;
+
+  SegmentedIterator() = default;
+
+  // Iterator converts to ConstIterator
+  template <class OtherContainer, class OtherValue,
+            class = std::enable_if_t<std::is_convertible_v<OtherValue*, ValueT*>>>
+  SegmentedIterator(const SegmentedIterator<OtherContainer, OtherValue>& other)  // NOLINT
+      : container_(other.container_), idx_(other.idx_) {
+  }
+
+  reference operator*() const {
+    return (*container_)[idx_];
+  }
+
+  pointer operator->() const {
+    return &(*container_)[idx_];
+  }
+
+  reference operator[](difference_type offset) const {
+    return (*container_)[idx_ + offset];
+  }
+
+  SegmentedIterator& operator++() {
+    ++idx_;
+    return *this;
+  }
+
+  SegmentedIterator operator++(int) {
+    SegmentedIterator copy = *this;
+    ++idx_;
+    return copy;
+  }
+
+  SegmentedIterator& operator--() {
+    --idx_;
+    return *this;
+  }
+
+  SegmentedIterator operator--(int) {
+    SegmentedIterator copy = *this;
+    --idx_;
+    return copy;
+  }
+
+  SegmentedIterator& operator+=(difference_type offset) {
+    idx_ += offset;
+    return *this;
+  }
+
+  SegmentedIterator& operator-=(difference_type offset) {
+    idx_ -= offset;
+    return *this;
+  }
+
+  friend SegmentedIterator operator+(SegmentedIterator it, difference_type offset) {
+    return it += offset;
+  }
+
+  friend SegmentedIterator operator+(difference_type offset, SegmentedIterator it) {
+    return it += offset;
+  }
+
+  friend SegmentedIterator operator-(SegmentedIterator it, difference_type offset) {
+    return it -= offset;
+  }
+
+  friend difference_type operator-(const SegmentedIterator& left, const SegmentedIterator& right) {
+    return static_cast<difference_type>(left.idx_) - static_cast<difference_type>(right.idx_);
+  }
+
+  // Compare operators
+  friend bool operator==(const SegmentedIterator& left, const SegmentedIterator& right) {
+    return left.idx_ == right.idx_;
+  }
+
+  friend bool operator!=(const SegmentedIterator& left, const SegmentedIterator& right) {
+    return left.idx_ != right.idx_;
+  }
+
+  friend bool operator<(const SegmentedIterator& left, const SegmentedIterator& right) {
+    return left.idx_ < right.idx_;
+  }
+
+  friend bool operator<=(const SegmentedIterator& left, const SegmentedIterator& right) {
+    return left.idx_ <= right.idx_;
+  }
+
+  friend bool operator>(const SegmentedIterator& left, const SegmentedIterator& right) {
+    return left.idx_ > right.idx_;
+  }
+
+  friend bool operator>=(const SegmentedIterator& left, const SegmentedIterator& right) {
+    return left.idx_ >= right.idx_;
+  }
+
+ private:
+  template <class, size_t>
+  friend class SegmentedVector;
+  template <class, class>
+  friend class SegmentedIterator;
+
+  Container* container_ = nullptr;
+  size_t idx_ = 0;
+
+  SegmentedIterator(Container* container, size_t idx) : container_(container), idx_(idx) {
+  }
+};
+
+// Append-only friendly sequence made of fixed-size chunks, each a Vector<T> reserved to ChunkSize elements and
+// never grown past it. Appending fills the last chunk or starts a new one, so elements are never relocated and
+// pointers and references to them stay valid until they are erased. Element i lives in chunk i / ChunkSize;
+// random access costs one extra load through the chunk index
+template <class T, size_t ChunkSize = DefaultChunkSize<T>()>
+class SegmentedVector {
+  static_assert(ChunkSize != 0 && (ChunkSize & (ChunkSize - 1)) == 0, "ChunkSize must be a power of two");
+
+ public:
+  using ValueType = T;
+  using Reference = T&;
+  using ConstReference = const T&;
+  using SizeType = size_t;
+  using Iterator = SegmentedIterator<SegmentedVector, T>;
+  using ConstIterator = SegmentedIterator<const SegmentedVector, const T>;
+
+  // Constructors
+  SegmentedVector() = default;
+
+  explicit SegmentedVector(size_t size) {
+    Reserve(size);
+    for (size_t i = 0; i < size; ++i) {
+      EmplaceBack();
+    }
+  }
+
+  SegmentedVector(size_t size, const T& value) {
+    Reserve(size);
+    for (size_t i = 0; i < size; ++i) {
+      PushBack(value);
+    }
+  }
+
+  SegmentedVector(std::initializer_list<T> init) {
+    Reserve(init.size());
+    for (const auto& value : init) {
+      PushBack(value);
+    }
+  }
+
+  // Copies are built chunk by chunk: copying a whole Vector<T> would size its buffer to the elements, and the
+  // next append would relocate them
+  SegmentedVector(const SegmentedVector& copy) {
+    chunks_.Reserve(copy.chunks_.Size());
+    for (size_t chunk = 0; chunk * ChunkSize < copy.size_; ++chunk) {
+      AddChunk();
+      chunks_[chunk].Append(copy.chunks_[chunk].begin(), copy.chunks_[chunk].end());
+      size_ += copy.chunks_[chunk].Size();
+    }
+  }
+
+  SegmentedVector(SegmentedVector&& move) noexcept
+      : chunks_(std::move(move.chunks_)), size_(std::exchange(move.size_, 0)) {
+  }
+
+  SegmentedVector& operator=(const SegmentedVector& copy) {
+    if (this != &copy) {
+      SegmentedVector tmp(copy);
+      Swap(tmp);
+    }
+    return *this;
+  }
+
+  SegmentedVector& operator=(SegmentedVector&& move) noexcept {
+    if (this != &move) {
+      chunks_ = std::move(move.chunks_);
+      size_ = std::exchange(move.size_, 0);
+    }
+    return *this;
+  }
+
+  // Methods
+  size_t Size() const {
+    return size_;
+  }
+
+  bool Empty() const {
+    return size_ == 0;
+  }
+
+  size_t Capacity() const {
+    return chunks_.Size() * ChunkSize;
+  }
+
+  size_t ChunkCount() const {
+    return chunks_.Size();
+  }
+
+  static constexpr size_t ChunkLength() {
+    return ChunkSize;
+  }
+
+  T& operator[](size_t idx) {
+    return chunks_[idx / ChunkSize][idx % ChunkSize];
+  }
+
+  const T& operator[](size_t idx) const {
+    return chunks_[idx / ChunkSize][idx % ChunkSize];
+  }
+
+  T& At(size_t idx) {
+    if (idx >= size_) {
+      throw std::out_of_range("Index overcomes border");
+    }
+    return (*this)[idx];
+  }
+
+  const T& At(size_t idx) const {
+    if (idx >= size_) {
+      throw std::out_of_range("Index overcomes border");
+    }
+    return (*this)[idx];
+  }
+
+  T& Front() {
+    return chunks_[0][0];
+  }
+
+  const T& Front() const {
+    return chunks_[0][0];
+  }
+
+  T& Back() {
+    return (*this)[size_ - 1];
+  }
+
+  const T& Back() const {
+    return (*this)[size_ - 1];
+  }
+
+  // Elements [chunk * ChunkSize, ...) are contiguous within one chunk
+  T* ChunkData(size_t chunk) {
+    return chunks_[chunk].Data();
+  }
+
+  const T* ChunkData(size_t chunk) const {
+    return chunks_[chunk].Data();
+  }
+
+  void PushBack(const T& value) {
+    EmplaceBack(value);
+  }
+
+  void PushBack(T&& value) {
+    EmplaceBack(std::move(value));
+  }
+
+  // Nothing moves, so `args` may refer to an element of this container
+  template <typename... Args>
+  void EmplaceBack(Args&&... args) {
+    size_t chunk = size_ / ChunkSize;
+    if (chunk == chunks_.Size()) {
+      AddChunk();
+    }
+    chunks_[chunk].EmplaceBack(std::forward<Args>(args)...);
+    ++size_;
+  }
+
+  void PopBack() {
+    if (size_ == 0) {
+      return;
+    }
+    chunks_[(size_ - 1) / ChunkSize].PopBack();
+    --size_;
+  }
+
+  // Destroys the elements but keeps the chunks for reuse
+  void Clear() {
+    for (size_t chunk = 0; chunk * ChunkSize < size_; ++chunk) {
+      chunks_[chunk].Clear();
+    }
+    size_ = 0;
+  }
+
+  // Allocates every chunk needed for `new_cap` elements up front, so the appends that follow allocate nothing
+  void Reserve(size_t new_cap) {
+    size_t chunks = (new_cap + ChunkSize - 1) / ChunkSize;
+    if (chunks <= chunks_.Size()) {
+      return;
+    }
+    chunks_.Reserve(chunks);
+    while (chunks_.Size() < chunks) {
+      AddChunk();
+    }
+  }
+
+  // Frees the chunks past the last element
+  void ShrinkToFit() {
+    size_t used = (size_ + ChunkSize - 1) / ChunkSize;
+    while (chunks_.Size() > used) {
+      chunks_.PopBack();
+    }
+    chunks_.ShrinkToFit();
+  }
+
+  void Swap(SegmentedVector& other) {
+    chunks_.Swap(other.chunks_);
+    std::swap(size_, other.size_);
+  }
+
+  // Visits the elements in order a chunk at a time, without the per-element index arithmetic of operator[]
+  template <class F>
+  void ForEach(F&& visit) {
+    for (size_t chunk = 0; chunk * ChunkSize < size_; ++chunk) {
+      for (auto& value : chunks_[chunk]) {
+        visit(value);
+      }
+    }
+  }
+
+  template <class F>
+  void ForEach(F&& visit) const {
+    for (size_t chunk = 0; chunk * ChunkSize < size_; ++chunk) {
+      for (const auto& value : chunks_[chunk]) {
+        visit(value);
+      }
+    }
+  }
+
+  // Iterators
+  Iterator begin() {  // NOLINT
+    return Iterator(this, 0);
+  }
+
+  Iterator end() {  // NOLINT
+    return Iterator(this, size_);
+  }
+
+  ConstIterator begin() const {  // NOLINT
+    return cbegin();
+  }
+
+  ConstIterator end() const {  // NOLINT
+    return cend();
+  }
+
+  ConstIterator cbegin() const {  // NOLINT
+    return ConstIterator(this, 0);
+  }
+
+  ConstIterator cend() const {  // NOLINT
+    return ConstIterator(this, size_);
+  }
+
+  // Compare operators
+  friend bool operator==(const SegmentedVector& left, const SegmentedVector& right) {
+    if (left.size_ != right.size_) {
+      return false;
+    }
+    for (size_t chunk = 0; chunk * ChunkSize < left.size_; ++chunk) {
+      if (left.chunks_[chunk] != right.chunks_[chunk]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  friend bool operator!=(const SegmentedVector& left, const SegmentedVector& right) {
+    return !(left == right);
+  }
+
+ private:
+  // The chunk index may relocate its Vector<T> headers as it grows; the element buffers they own stay put
+  Vector<Vector<T>> chunks_;
+  size_t size_ = 0;
+
+  void AddChunk() {
+    Vector<T> chunk;
+    chunk.Reserve(ChunkSize);
+    chunks_.EmplaceBack(std::move(chunk));
+  }
+};
+
+#endif  // SEGMENTED_VECTOR_H_
@@ -3,9 +3,15 @@
 
 #define WEAK_PTR_IMPLEMENTED
 
+#include <atomic>
 #include <cstdlib>
 #include <functional>
 #include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "control_block_pool.h"
 
 // BadWeakPtr exception
 class BadWeakPtr : public std::exception_ptr {
@@ -14,84 +20,277 @@ class BadWeakPtr : public std::exception_ptr {
   }
 };
 
-// COUNTER
+// COUNTERS
+// Both counters below are reference count policies for SharedPtr and WeakPtr. The strong owners together hold one
+// weak reference, dropped by whoever releases the last strong one, so the counter dies exactly when RmWeak
+// reports zero and never while an owner is still looking at it. A counter is the base of a control block (see
+// PointerBlock and InlineBlock below), which knows how to destroy the object and free itself
+
+// Plain counts for pointers that never leave one thread
 class Counter {
  public:
-  bool EmptyStrong() {
-    return strong_count_ == 0;
+  size_t GetStrong() const {
+    return strong_count_;
   }
 
-  size_t GetStrong() {
-    return strong_count_;
+  bool IsUnique() const {
+    return strong_count_ == 1;
   }
 
   void AddStrong() {
     strong_count_++;
   }
 
-  void RmStrong() {
-    strong_count_--;
+  // Takes a strong reference unless the object is already gone
+  bool TryAddStrong() {
+    if (strong_count_ == 0) {
+      return false;
+    }
+    strong_count_++;
+    return true;
+  }
+
+  // Returns true when the last strong reference goes
+  bool RmStrong() {
+    return --strong_count_ == 0;
+  }
+
+  void AddWeak() {
+    weak_count_++;
+  }
+
+  // Returns true when the counter itself may be freed
+  bool RmWeak() {
+    return --weak_count_ == 0;
+  }
+
+  // Destroys the object once the last strong reference is gone
+  virtual void Destroy() = 0;
+
+  // Frees the control block once the last weak reference is gone
+  virtual void Deallocate() = 0;
+
+ protected:
+  ~Counter() = default;
+
+ private:
+  size_t strong_count_ = 1;
+  size_t weak_count_ = 1;
+};
+
+// Atomic counts for pointers shared between threads. A new reference is always taken from one that is already
+// held, so increments are relaxed; the final decrement is acq_rel, so every owner's writes to the object happen
+// before its destruction. Locking a WeakPtr only ever moves the strong count up from a nonzero value, with a CAS,
+// so it cannot revive an object whose destruction has begun
+class AtomicCounter {
+ public:
+  size_t GetStrong() const {
+    return strong_count_.load(std::memory_order_relaxed);
+  }
+
+  // Acquire pairs with the release half of RmStrong: once the other owners are gone, everything they did with
+  // the object happens before what the sole owner does next
+  bool IsUnique() const {
+    return strong_count_.load(std::memory_order_acquire) == 1;
   }
 
-  bool EmptyWeak() {
-    return weak_count_ == 0;
+  void AddStrong() {
+    strong_count_.fetch_add(1, std::memory_order_relaxed);
   }
 
-  size_t GetWeak() {
-    return weak_count_;
+  bool TryAddStrong() {
+    size_t count = strong_count_.load(std::memory_order_relaxed);
+    while (count != 0) {
+      if (strong_count_.compare_exchange_weak(count, count + 1, std::memory_order_acq_rel,
+                                              std::memory_order_relaxed)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool RmStrong() {
+    return strong_count_.fetch_sub(1, std::memory_order_acq_rel) == 1;
   }
 
   void AddWeak() {
-    weak_count_++;
+    weak_count_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // A count of one is our own reference and nobody can add another, so the common last release skips the RMW
+  bool RmWeak() {
+    if (weak_count_.load(std::memory_order_acquire) == 1) {
+      return true;
+    }
+    return weak_count_.fetch_sub(1, std::memory_order_acq_rel) == 1;
+  }
+
+  // Destroys the object once the last strong reference is gone
+  virtual void Destroy() = 0;
+
+  // Frees the control block once the last weak reference is gone
+  virtual void Deallocate() = 0;
+
+ protected:
+  ~AtomicCounter() = default;
+
+ private:
+  std::atomic<size_t> strong_count_{1};
+  std::atomic<size_t> weak_count_{1};
+};
+
+template <class Alloc, class Block>
+using ReboundAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<Block>;
+
+// Keeps the allocator a control block was allocated with; empty allocators take no space
+template <class Alloc, bool = std::is_empty_v<Alloc> && !std::is_final_v<Alloc>>
+class BlockAllocator : private Alloc {
+ protected:
+  explicit BlockAllocator(const Alloc& alloc) : Alloc(alloc) {
+  }
+
+  Alloc GetBlockAllocator() const {
+    return *this;
+  }
+};
+
+template <class Alloc>
+class BlockAllocator<Alloc, false> {
+ protected:
+  explicit BlockAllocator(const Alloc& alloc) : alloc_(alloc) {
+  }
+
+  Alloc GetBlockAllocator() const {
+    return alloc_;
+  }
+
+ private:
+  Alloc alloc_;
+};
+
+// Control block of SharedPtr(T*): the object was allocated separately and is deleted through the pointer; the
+// block itself comes from Alloc, the thread-local ControlBlockPool unless another allocator is given
+template <class T, class CounterT, class Alloc>
+class PointerBlock final : public CounterT,
+                           private BlockAllocator<ReboundAlloc<Alloc, PointerBlock<T, CounterT, Alloc>>> {
+ public:
+  static PointerBlock* Create(T* ptr, const Alloc& alloc) {
+    BlockAlloc block_alloc(alloc);
+    PointerBlock* block = BlockTraits::allocate(block_alloc, 1);
+    return new (block) PointerBlock(ptr, block_alloc);
+  }
+
+  void Destroy() override {
+    delete ptr_;
+  }
+
+  void Deallocate() override {
+    BlockAlloc block_alloc = this->GetBlockAllocator();
+    this->~PointerBlock();
+    BlockTraits::deallocate(block_alloc, this, 1);
+  }
+
+ private:
+  using BlockAlloc = ReboundAlloc<Alloc, PointerBlock>;
+  using BlockTraits = std::allocator_traits<BlockAlloc>;
+
+  T* ptr_;
+
+  PointerBlock(T* ptr, const BlockAlloc& block_alloc) : BlockAllocator<BlockAlloc>(block_alloc), ptr_(ptr) {
+  }
+};
+
+// Control block of MakeShared and AllocateShared: the object is built right after the counts, so one allocation
+// holds both and the first access to the object usually finds the counts' cache line already loaded
+template <class T, class CounterT, class Alloc>
+class InlineBlock final : public CounterT,
+                          private BlockAllocator<ReboundAlloc<Alloc, InlineBlock<T, CounterT, Alloc>>> {
+ public:
+  template <class... Args>
+  static InlineBlock* Create(const Alloc& alloc, Args&&... args) {
+    BlockAlloc block_alloc(alloc);
+    InlineBlock* block = BlockTraits::allocate(block_alloc, 1);
+    try {
+      return new (block) InlineBlock(block_alloc, std::forward<Args>(args)...);
+    } catch (...) {
+      BlockTraits::deallocate(block_alloc, block, 1);
+      throw;
+    }
+  }
+
+  T* Get() {
+    return std::launder(reinterpret_cast<T*>(storage_));
+  }
+
+  void Destroy() override {
+    std::destroy_at(Get());
   }
 
-  void RmWeak() {
-    weak_count_--;
+  void Deallocate() override {
+    BlockAlloc block_alloc = this->GetBlockAllocator();
+    this->~InlineBlock();
+    BlockTraits::deallocate(block_alloc, this, 1);
   }
 
  private:
-  size_t strong_count_ = 0;
-  size_t weak_count_ = 0;
+  using BlockAlloc = ReboundAlloc<Alloc, InlineBlock>;
+  using BlockTraits = std::allocator_traits<BlockAlloc>;
+
+  alignas(T) unsigned char storage_[sizeof(T)];
+
+  template <class... Args>
+  explicit InlineBlock(const BlockAlloc& block_alloc, Args&&... args) : BlockAllocator<BlockAlloc>(block_alloc) {
+    new (storage_) T(std::forward<Args>(args)...);
+  }
 };
 
-template <class T>
+template <class T, class CounterT>
 class WeakPtr;
 
 // SHARED
-template <class T>
+// CounterT is AtomicCounter by default; Counter skips the atomic operations for single-threaded use
+template <class T, class CounterT = AtomicCounter>
 class SharedPtr {
  public:
   // Fields
   T* ptr_ = nullptr;
-  Counter* counter_ = nullptr;
+  CounterT* counter_ = nullptr;
 
   // Constructors
   SharedPtr() = default;
 
+  // If the control block cannot be allocated, `ptr` is deleted before the exception leaves
   explicit SharedPtr(T* ptr) : ptr_(ptr) {
     if (ptr) {
-      counter_ = new Counter();
-      counter_->AddStrong();
+      counter_ = NewBlock(ptr, PoolAllocator<T>());
     }
   }
 
-  SharedPtr(const WeakPtr<T>& weak) : ptr_(weak.ptr_), counter_(weak.counter_) {  // NOLINT
-    if (counter_ && counter_->GetStrong() > 0) {
-      counter_->AddStrong();
-    } else {
+  // Takes the control block from `alloc` instead of the thread-local pool
+  template <class Alloc>
+  SharedPtr(T* ptr, const Alloc& alloc) : ptr_(ptr) {
+    if (ptr) {
+      counter_ = NewBlock(ptr, alloc);
+    }
+  }
+
+  SharedPtr(const WeakPtr<T, CounterT>& weak) : ptr_(weak.ptr_), counter_(weak.counter_) {  // NOLINT
+    if (!counter_ || !counter_->TryAddStrong()) {
+      ptr_ = nullptr;
+      counter_ = nullptr;
       throw BadWeakPtr{};
     }
   }
 
   // Copy constructor
-  SharedPtr(const SharedPtr<T>& shared) : ptr_(shared.ptr_), counter_(shared.counter_) {
+  SharedPtr(const SharedPtr& shared) : ptr_(shared.ptr_), counter_(shared.counter_) {
     if (counter_) {
       counter_->AddStrong();
     }
   }
 
   // Move constructor
-  SharedPtr(SharedPtr<T>&& shared) noexcept : ptr_(shared.ptr_), counter_(shared.counter_) {
+  SharedPtr(SharedPtr&& shared) noexcept : ptr_(shared.ptr_), counter_(shared.counter_) {
     shared.ptr_ = nullptr;
     shared.counter_ = nullptr;
   }
@@ -102,7 +301,7 @@ class SharedPtr {
   }
 
   // Copy assign
-  SharedPtr<T>& operator=(const SharedPtr<T>& shared) {
+  SharedPtr& operator=(const SharedPtr& shared) {
     if (this == &shared) {
       return *this;
     }
@@ -118,7 +317,7 @@ class SharedPtr {
   }
 
   // Move assign
-  SharedPtr<T>& operator=(SharedPtr<T>&& shared) noexcept {
+  SharedPtr& operator=(SharedPtr&& shared) noexcept {
     if (this == &shared) {
       return *this;
     }
@@ -138,14 +337,12 @@ class SharedPtr {
       return;
     }
 
+    // The new block is allocated before the old one is released, so a failed allocation leaves this pointer empty
+    // rather than holding the `ptr` NewBlock has just deleted
+    CounterT* counter = ptr ? NewBlock(ptr, PoolAllocator<T>()) : nullptr;
     Release();
     ptr_ = ptr;
-    if (ptr) {
-      counter_ = new Counter();
-      counter_->AddStrong();
-    } else {
-      counter_ = nullptr;
-    }
+    counter_ = counter;
   }
 
   void Swap(SharedPtr& shared) {
@@ -161,6 +358,12 @@ class SharedPtr {
     return counter_ ? counter_->GetStrong() : 0;
   }
 
+  // True when no other SharedPtr owns the object, so it may be changed in place. Unlike UseCount() == 1 this
+  // synchronizes with the other owners' releases; a WeakPtr can still Lock the object afterwards
+  bool Unique() const {
+    return counter_ && counter_->IsUnique();
+  }
+
   // Operators
   T& operator*() const {
     return *ptr_;
@@ -175,14 +378,23 @@ class SharedPtr {
   }
 
  private:
+  template <class Alloc>
+  static CounterT* NewBlock(T* ptr, const Alloc& alloc) {
+    try {
+      return PointerBlock<T, CounterT, Alloc>::Create(ptr, alloc);
+    } catch (...) {
+      delete ptr;
+      throw;
+    }
+  }
+
   void Release() {
     if (counter_) {
-      counter_->RmStrong();
-      if (counter_->EmptyStrong()) {
-        if (counter_->EmptyWeak()) {
-          delete counter_;
+      if (counter_->RmStrong()) {
+        counter_->Destroy();
+        if (counter_->RmWeak()) {
+          counter_->Deallocate();
         }
-        delete ptr_;
       }
       ptr_ = nullptr;
       counter_ = nullptr;
@@ -191,30 +403,30 @@ class SharedPtr {
 };
 
 // WEAK
-template <class T>
+template <class T, class CounterT = AtomicCounter>
 class WeakPtr {
  public:
   T* ptr_ = nullptr;
-  Counter* counter_ = nullptr;
+  CounterT* counter_ = nullptr;
 
   // Constructors
   WeakPtr() = default;
 
-  WeakPtr(const SharedPtr<T>& shared) : ptr_(shared.ptr_), counter_(shared.counter_) {  // NOLINT
+  WeakPtr(const SharedPtr<T, CounterT>& shared) : ptr_(shared.ptr_), counter_(shared.counter_) {  // NOLINT
     if (counter_) {
       counter_->AddWeak();
     }
   }
 
   // Copy constructor
-  WeakPtr(const WeakPtr<T>& weak) : ptr_(weak.ptr_), counter_(weak.counter_) {
+  WeakPtr(const WeakPtr& weak) : ptr_(weak.ptr_), counter_(weak.counter_) {
     if (counter_) {
       counter_->AddWeak();
     }
   }
 
   // Move constructor
-  WeakPtr(WeakPtr<T>&& weak) noexcept : ptr_(weak.ptr_), counter_(weak.counter_) {
+  WeakPtr(WeakPtr&& weak) noexcept : ptr_(weak.ptr_), counter_(weak.counter_) {
     weak.ptr_ = nullptr;
     weak.counter_ = nullptr;
   }
@@ -225,7 +437,7 @@ class WeakPtr {
   }
 
   // Copy assign
-  WeakPtr<T>& operator=(const WeakPtr<T>& weak) {
+  WeakPtr& operator=(const WeakPtr& weak) {
     if (this == &weak) {
       return *this;
     }
@@ -233,13 +445,15 @@ class WeakPtr {
     Release();
     ptr_ = weak.ptr_;
     counter_ = weak.counter_;
-    counter_->AddWeak();
+    if (counter_) {
+      counter_->AddWeak();
+    }
 
     return *this;
   }
 
   // Move assign
-  WeakPtr<T>& operator=(WeakPtr<T>&& weak) noexcept {
+  WeakPtr& operator=(WeakPtr&& weak) noexcept {
     if (this == &weak) {
       return *this;
     }
@@ -254,7 +468,7 @@ class WeakPtr {
   }
 
   // Methods
-  void Swap(WeakPtr<T>& weak) {
+  void Swap(WeakPtr& weak) {
     std::swap(ptr_, weak.ptr_);
     std::swap(counter_, weak.counter_);
   }
@@ -270,33 +484,46 @@ class WeakPtr {
   }
 
   bool Expired() const {
-    return counter_ == nullptr || counter_->EmptyStrong();
+    return counter_ == nullptr || counter_->GetStrong() == 0;
   }
 
-  SharedPtr<T> Lock() const {
-    if (Expired()) {
-      return SharedPtr<T>();
+  // Expired() followed by a copy could race with the last owner; TryAddStrong checks and increments in one step
+  SharedPtr<T, CounterT> Lock() const {
+    SharedPtr<T, CounterT> shared;
+    if (counter_ && counter_->TryAddStrong()) {
+      shared.ptr_ = ptr_;
+      shared.counter_ = counter_;
     }
-    return SharedPtr<T>(*this);
+    return shared;
   }
 
  private:
   void Release() {
     if (counter_) {
-      counter_->RmWeak();
-      if (counter_->EmptyStrong() && counter_->EmptyWeak()) {
-        delete counter_;
+      if (counter_->RmWeak()) {
+        counter_->Deallocate();
       }
       counter_ = nullptr;
     }
   }
 };
 
+// AllocateShared
+// One allocation from `alloc` holds the counts and the object. The object is destroyed when the last SharedPtr goes
+// and the memory is given back to `alloc` when the last WeakPtr goes
+template <class T, class CounterT = AtomicCounter, class Alloc, class... Args>
+SharedPtr<T, CounterT> AllocateShared(const Alloc& alloc, Args&&... args) {
+  auto* block = InlineBlock<T, CounterT, Alloc>::Create(alloc, std::forward<Args>(args)...);
+  SharedPtr<T, CounterT> shared;
+  shared.ptr_ = block->Get();
+  shared.counter_ = block;
+  return shared;
+}
+
 // MakeShared
-template <class T, class... Args>
-std::shared_ptr<T> MakeShared(Args&&... args) {
-  T* ptr = new T(std::forward<Args>(args)...);
-  return std::shared_ptr<T>(ptr);
+template <class T, class CounterT = AtomicCounter, class... Args>
+SharedPtr<T, CounterT> MakeShared(Args&&... args) {
+  return AllocateShared<T, CounterT>(std::allocator<T>(), std::forward<Args>(args)...);
 }
 
 #endif  // SHARED_PTR_H_
\ No newline at end of file
@@ -0,0 +1,289 @@
+#ifndef SOA_VECTOR_H_
+#define SOA_VECTOR_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "vector.h"
+
+// Contiguous run of one column's elements; a pointer and a length, valid until the container reallocates
+template <class T>
+class ColumnSpan {
+ public:
+  using Iterator = T*;
+
+  // Constructors
+  ColumnSpan() = default;
+
+  ColumnSpan(T* data, size_t size) : data_(data), size_(size) {
+  }
+
+  // Methods
+  T* Data() const {
+    return data_;
+  }
+
+  size_t Size() const {
+    return size_;
+  }
+
+  bool Empty() const {
+    return size_ == 0;
+  }
+
+  T& operator[](size_t idx) const {
+    return data_[idx];
+  }
+
+  // Iterators
+  Iterator begin() const {  // NOLINT
+    return data_;
+  }
+
+  Iterator end() const {  // NOLINT
+    return data_ + size_;
+  }
+
+ private:
+  T* data_ = nullptr;
+  size_t size_ = 0;
+};
+
+// One row of a SoaVector seen through references into its columns; Refs are T& or const T&
+template <class... Refs>
+class SoaRow {
+ public:
+  explicit SoaRow(Refs... refs) : refs_(refs...) {
+  }
+
+  template <size_t I>
+  std::tuple_element_t<I, std::tuple<Refs...>> Get() const {
+    return std::get<I>(refs_);
+  }
+
+  // Copies the row out of the container
+  std::tuple<std::decay_t<Refs>...> Value() const {
+    return refs_;
+  }
+
+  // Assigns every field of the row
+  template <class... Values>
+  SoaRow& operator=(const std::tuple<Values...>& values) {
+    static_assert(sizeof...(Values) == sizeof...(Refs), "a row is assigned one value per field");
+    refs_ = values;
+    return *this;
+  }
+
+ private:
+  std::tuple<Refs...> refs_;
+};
+
+// Structure of arrays: field I of every row is stored contiguously in column I, a Vector<FieldI>. All columns
+// share one size and one capacity and grow together, so a loop over a few fields only streams those columns.
+// Column<I>() hands out the raw column for vectorized kernels; operator[] gives a row proxy
+template <class... Fields>
+class SoaVector {
+  static_assert(sizeof...(Fields) != 0, "SoaVector needs at least one field");
+
+ public:
+  using Row = SoaRow<Fields&...>;
+  using ConstRow = SoaRow<const Fields&...>;
+  using ValueType = std::tuple<Fields...>;
+
+  static constexpr size_t kFieldCount = sizeof...(Fields);
+
+  template <size_t I>
+  using FieldType = std::tuple_element_t<I, ValueType>;
+
+  // Constructors
+  SoaVector() = default;
+
+  explicit SoaVector(size_t size) {
+    Resize(size);
+  }
+
+  SoaVector(const SoaVector& copy) : columns_(copy.columns_), size_(copy.size_), capacity_(MinCapacity()) {
+  }
+
+  SoaVector(SoaVector&& move) noexcept
+      : columns_(std::move(move.columns_)),
+        size_(std::exchange(move.size_, 0)),
+        capacity_(std::exchange(move.capacity_, 0)) {
+  }
+
+  SoaVector& operator=(const SoaVector& copy) {
+    if (this != &copy) {
+      SoaVector tmp(copy);
+      Swap(tmp);
+    }
+    return *this;
+  }
+
+  SoaVector& operator=(SoaVector&& move) noexcept {
+    if (this != &move) {
+      columns_ = std::move(move.columns_);
+      size_ = std::exchange(move.size_, 0);
+      capacity_ = std::exchange(move.capacity_, 0);
+    }
+    return *this;
+  }
+
+  // Methods
+  size_t Size() const {
+    return size_;
+  }
+
+  bool Empty() const {
+    return size_ == 0;
+  }
+
+  size_t Capacity() const {
+    return capacity_;
+  }
+
+  template <size_t I>
+  ColumnSpan<FieldType<I>> Column() {
+    return ColumnSpan<FieldType<I>>(std::get<I>(columns_).Data(), size_);
+  }
+
+  template <size_t I>
+  ColumnSpan<const FieldType<I>> Column() const {
+    return ColumnSpan<const FieldType<I>>(std::get<I>(columns_).Data(), size_);
+  }
+
+  Row operator[](size_t idx) {
+    return RowAt(idx, kIndices);
+  }
+
+  ConstRow operator[](size_t idx) const {
+    return RowAt(idx, kIndices);
+  }
+
+  Row At(size_t idx) {
+    if (idx >= size_) {
+      throw std::out_of_range("Index overcomes border");
+    }
+    return RowAt(idx, kIndices);
+  }
+
+  ConstRow At(size_t idx) const {
+    if (idx >= size_) {
+      throw std::out_of_range("Index overcomes border");
+    }
+    return RowAt(idx, kIndices);
+  }
+
+  // Either every column gets the new field or, if one of them throws, none does
+  void PushBack(Fields... values) {
+    if (size_ == capacity_) {
+      Reserve(std::max(static_cast<size_t>(static_cast<double>(capacity_) * kDefaultGrowthFactor), capacity_ + 1));
+    }
+    AppendRow(kIndices, std::move(values)...);
+    ++size_;
+  }
+
+  void PopBack() {
+    if (size_ == 0) {
+      return;
+    }
+    std::apply([](auto&... column) { (column.PopBack(), ...); }, columns_);
+    --size_;
+  }
+
+  void Clear() {
+    std::apply([](auto&... column) { (column.Clear(), ...); }, columns_);
+    size_ = 0;
+  }
+
+  // Reserves every column before the first one is touched by an append, so growth is one step for all of them
+  void Reserve(size_t new_cap) {
+    if (new_cap <= capacity_) {
+      return;
+    }
+    std::apply([new_cap](auto&... column) { (column.Reserve(new_cap), ...); }, columns_);
+    capacity_ = new_cap;
+  }
+
+  // New rows are value-initialized. If a column throws, the columns already resized go back to the old size
+  void Resize(size_t new_size) {
+    Reserve(new_size);
+    ResizeColumns(new_size, kIndices);
+    size_ = new_size;
+  }
+
+  void ShrinkToFit() {
+    std::apply([](auto&... column) { (column.ShrinkToFit(), ...); }, columns_);
+    capacity_ = MinCapacity();
+  }
+
+  void Swap(SoaVector& other) {
+    std::swap(columns_, other.columns_);
+    std::swap(size_, other.size_);
+    std::swap(capacity_, other.capacity_);
+  }
+
+  // Calls visit(field0, field1, ...) for every row in order
+  template <class F>
+  void ForEachRow(F&& visit) {
+    for (size_t idx = 0; idx < size_; ++idx) {
+      std::apply([&visit, idx](auto&... column) { visit(column[idx]...); }, columns_);
+    }
+  }
+
+  template <class F>
+  void ForEachRow(F&& visit) const {
+    for (size_t idx = 0; idx < size_; ++idx) {
+      std::apply([&visit, idx](const auto&... column) { visit(column[idx]...); }, columns_);
+    }
+  }
+
+ private:
+  static constexpr auto kIndices = std::index_sequence_for<Fields...>();
+
+  std::tuple<Vector<Fields>...> columns_;
+  size_t size_ = 0;
+  size_t capacity_ = 0;
+
+  size_t MinCapacity() const {
+    return std::apply([](const auto&... column) { return std::min({column.Capacity()...}); }, columns_);
+  }
+
+  template <size_t... I>
+  Row RowAt(size_t idx, std::index_sequence<I...>) {
+    return Row(std::get<I>(columns_)[idx]...);
+  }
+
+  template <size_t... I>
+  ConstRow RowAt(size_t idx, std::index_sequence<I...>) const {
+    return ConstRow(std::get<I>(columns_)[idx]...);
+  }
+
+  // Capacity is already reserved, so only a field constructor can throw; the fields appended before it are popped
+  template <size_t... I>
+  void AppendRow(std::index_sequence<I...>, Fields&&... values) {
+    size_t done = 0;
+    try {
+      ((std::get<I>(columns_).EmplaceBack(std::move(values)), ++done), ...);
+    } catch (...) {
+      ((I < done ? std::get<I>(columns_).PopBack() : void()), ...);
+      throw;
+    }
+  }
+
+  template <size_t... I>
+  void ResizeColumns(size_t new_size, std::index_sequence<I...>) {
+    size_t done = 0;
+    try {
+      ((std::get<I>(columns_).Resize(new_size), ++done), ...);
+    } catch (...) {
+      ((I < done ? std::get<I>(columns_).Resize(size_) : void()), ...);
+      throw;
+    }
+  }
+};
+
+#endif  // SOA_VECTOR_H_
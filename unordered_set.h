@@ -5,50 +5,258 @@
 #include <list>
 #include <functional>
 #include <utility>
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <type_traits>
+
+#include "algorithms.h"
+#include "hash_mix.h"
 
 const float kMaxLoadFactor = 1.0;
 
+// Bulk builds hash on several threads once each one gets at least this many keys
+const size_t kParallelHashThreshold = 1 << 16;
+// Bulk builds scatter keys into this many contiguous bucket ranges before filling them
+const size_t kBulkPartitions = 1024;
+// ForEachPrefetched requests the first node of the bucket this many positions ahead
+const size_t kPrefetchDistance = 16;
+
+// kCacheHash keeps each element's full hash in its node, so rehashing and mismatching lookups skip std::hash
+// and operator==; kPowerOfTwo keeps the bucket count a power of two and picks buckets by mask after MixHash
+template <bool CacheHash = false, bool PowerOfTwo = false>
+struct SetPolicy {
+  static constexpr bool kCacheHash = CacheHash;
+  static constexpr bool kPowerOfTwo = PowerOfTwo;
+};
+
+// Nodes are built in place from the key constructor arguments; the hash is only kept when the policy caches it
+template <class KeyT, bool CacheHash>
+struct SetNode {
+  template <class... Args>
+  explicit SetNode(size_t, Args&&... args) : key(std::forward<Args>(args)...) {
+  }
+
+  KeyT key;
+};
+
 template <class KeyT>
+struct SetNode<KeyT, true> {
+  template <class... Args>
+  explicit SetNode(size_t hash, Args&&... args) : key(std::forward<Args>(args)...), hash(hash) {
+  }
+
+  KeyT key;
+  size_t hash;
+};
+
+// Forward iterator over the keys of both tables (the second one is only non-empty mid-migration)
+template <class KeyT, class Table>
+class SetIterator {
+ public:
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = KeyT;
+  using difference_type = std::ptrdiff_t;
+  using pointer = const KeyT*;
+  using reference = const KeyT&;
+
+  SetIterator() = default;
+
+  reference operator*() const {
+    return node_->key;
+  }
+
+  pointer operator->() const {
+    return &node_->key;
+  }
+
+  SetIterator& operator++() {
+    ++node_;
+    SkipEmpty();
+    return *this;
+  }
+
+  SetIterator operator++(int) {
+    SetIterator copy = *this;
+    ++*this;
+    return copy;
+  }
+
+  bool operator==(const SetIterator& other) const {
+    return table_ == other.table_ && bucket_ == other.bucket_ && (table_ == 2 || node_ == other.node_);
+  }
+
+  bool operator!=(const SetIterator& other) const {
+    return !(*this == other);
+  }
+
+ private:
+  template <class, class, class, class, class>
+  friend class UnorderedSet;
+
+  using NodeIterator = typename Table::value_type::const_iterator;
+
+  const Table* tables_[2] = {nullptr, nullptr};
+  size_t table_ = 2;
+  size_t bucket_ = 0;
+  NodeIterator node_;
+
+  SetIterator(const Table* first, const Table* second) : tables_{first, second}, table_(0) {
+    if (!tables_[0]->empty()) {
+      node_ = (*tables_[0])[0].begin();
+    }
+    SkipEmpty();
+  }
+
+  void SkipEmpty() {
+    while (table_ < 2) {
+      const Table& table = *tables_[table_];
+      if (bucket_ < table.size() && node_ != table[bucket_].end()) {
+        return;
+      }
+      if (bucket_ + 1 < table.size()) {
+        node_ = table[++bucket_].begin();
+        continue;
+      }
+      ++table_;
+      bucket_ = 0;
+      if (table_ < 2 && !tables_[table_]->empty()) {
+        node_ = (*tables_[table_])[0].begin();
+      }
+    }
+  }
+};
+
+// Owns at most one node extracted from a set; inserting it into a set with an equal allocator relinks the node
+// without copying the key or touching the allocator
+template <class KeyT, class List>
+class SetNodeHandle {
+ public:
+  SetNodeHandle() = default;
+
+  bool Empty() const {
+    return list_.empty();
+  }
+
+  explicit operator bool() const {
+    return !Empty();
+  }
+
+  KeyT& Value() {
+    return list_.front().key;
+  }
+
+  const KeyT& Value() const {
+    return list_.front().key;
+  }
+
+ private:
+  template <class, class, class, class, class>
+  friend class UnorderedSet;
+
+  explicit SetNodeHandle(List list) : list_(std::move(list)) {
+  }
+
+  List list_;
+};
+
+// Hash, KeyEqual and Allocator are held by value; both the bucket array and every list node are allocated through
+// rebound copies of the allocator
+template <class KeyT, class Hash = SetHash<KeyT>, class KeyEqual = std::equal_to<>,
+          class Allocator = std::allocator<KeyT>, class Policy = SetPolicy<>>
 class UnorderedSet {
+  using Node = SetNode<KeyT, Policy::kCacheHash>;
+  using NodeAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<Node>;
+  using List = std::list<Node, NodeAllocator>;
+  template <class T>
+  using Rebound = typename std::allocator_traits<Allocator>::template rebind_alloc<T>;
+  using Table = std::vector<List, Rebound<List>>;
+  // Staging buffers of bulk inserts come from the set's allocator like everything else it owns
+  template <class T>
+  using Buffer = std::vector<T, Rebound<T>>;
+
  public:
+  using NodeHandle = SetNodeHandle<KeyT, List>;
+  using ConstIterator = SetIterator<KeyT, Table>;
+  using Iterator = ConstIterator;
+
   // Constructors
   UnorderedSet() = default;
 
-  explicit UnorderedSet(size_t count) : table_(count) {
+  explicit UnorderedSet(size_t count, const Hash& hash = Hash(), const KeyEqual& equal = KeyEqual(),
+                        const Allocator& alloc = Allocator())
+      : hasher_(hash), key_equal_(equal), alloc_(alloc), table_(MakeTable(NormalizeBucketCount(count))) {
+  }
+
+  explicit UnorderedSet(const Allocator& alloc) : alloc_(alloc), table_(MakeTable(0)), old_table_(MakeTable(0)) {
   }
 
   template <typename It>
-  UnorderedSet(It begin, It end) : n_elements_(0) {
-    size_t distance = std::distance(begin, end);
-    table_.resize(distance);
-    for (auto it = begin; it != end; ++it) {
-      auto val = *it;
-      table_[Hash(val)].push_back(val);
-    }
-    n_elements_ += distance;
+  UnorderedSet(It begin, It end) {
+    InsertRange(begin, end);
   }
 
-  UnorderedSet(const UnorderedSet<KeyT>& other) : table_(other.table_), n_elements_(other.n_elements_) {
+  UnorderedSet(const UnorderedSet& other)
+      : hasher_(other.hasher_),
+        key_equal_(other.key_equal_),
+        alloc_(other.alloc_),
+        table_(other.table_),
+        old_table_(other.old_table_),
+        n_elements_(other.n_elements_),
+        old_bucket_count_(other.old_bucket_count_),
+        pending_buckets_(other.pending_buckets_),
+        rehash_step_(other.rehash_step_) {
   }
 
-  UnorderedSet(UnorderedSet<KeyT>&& other) noexcept : table_(std::move(other.table_)), n_elements_(other.n_elements_) {
+  UnorderedSet(UnorderedSet&& other) noexcept
+      : hasher_(std::move(other.hasher_)),
+        key_equal_(std::move(other.key_equal_)),
+        alloc_(std::move(other.alloc_)),
+        table_(std::move(other.table_)),
+        old_table_(std::move(other.old_table_)),
+        n_elements_(other.n_elements_),
+        old_bucket_count_(other.old_bucket_count_),
+        pending_buckets_(other.pending_buckets_),
+        rehash_step_(other.rehash_step_) {
+    other.old_table_.clear();
     other.n_elements_ = 0;
+    other.old_bucket_count_ = 0;
+    other.pending_buckets_ = 0;
   }
 
   // Copy/move assigns
-  UnorderedSet<KeyT>& operator=(const UnorderedSet<KeyT>& other) {
+  UnorderedSet& operator=(const UnorderedSet& other) {
     if (this != &other) {
+      hasher_ = other.hasher_;
+      key_equal_ = other.key_equal_;
+      alloc_ = other.alloc_;
       table_ = other.table_;
+      old_table_ = other.old_table_;
       n_elements_ = other.n_elements_;
+      old_bucket_count_ = other.old_bucket_count_;
+      pending_buckets_ = other.pending_buckets_;
+      rehash_step_ = other.rehash_step_;
     }
     return *this;
   }
 
-  UnorderedSet<KeyT>& operator=(UnorderedSet<KeyT>&& other) noexcept {
+  UnorderedSet& operator=(UnorderedSet&& other) noexcept {
     if (this != &other) {
+      hasher_ = std::move(other.hasher_);
+      key_equal_ = std::move(other.key_equal_);
+      alloc_ = std::move(other.alloc_);
       table_ = std::move(other.table_);
+      old_table_ = std::move(other.old_table_);
       n_elements_ = other.n_elements_;
+      old_bucket_count_ = other.old_bucket_count_;
+      pending_buckets_ = other.pending_buckets_;
+      rehash_step_ = other.rehash_step_;
+      other.old_table_.clear();
       other.n_elements_ = 0;
+      other.old_bucket_count_ = 0;
+      other.pending_buckets_ = 0;
     }
     return *this;
   }
@@ -67,78 +275,155 @@ class UnorderedSet {
     return n_elements_ == 0;
   }
 
+  // Counts the buckets of the new table still waiting to be built while growing incrementally
   size_t BucketCount() const {
-    return table_.size();
+    return table_.size() + pending_buckets_;
   }
 
   size_t BucketSize(const size_t id) const {
-    if (id >= BucketCount()) {
+    if (id >= table_.size()) {
       return 0;
     }
     return table_[id].size();
   }
 
   size_t Bucket(const KeyT& key) const {
-    return Hash(key);
+    return BucketIndex(key);
+  }
+
+  template <class K, class = EnableIfTransparent<Hash, KeyEqual, K>>
+  size_t Bucket(const K& key) const {
+    return BucketIndex(key);
   }
 
   double LoadFactor() const {
-    return n_elements_ / std::max(static_cast<double>(table_.size()), 1.0);
+    return n_elements_ / std::max(static_cast<double>(BucketCount()), 1.0);
   }
 
   void Clear() {
     table_.clear();
+    old_table_.clear();
     n_elements_ = 0;
+    old_bucket_count_ = 0;
+    pending_buckets_ = 0;
   }
 
   bool Find(const KeyT& key) const {
-    if (BucketCount() == 0) {
-      return false;
-    }
-    auto hash = Hash(key);
-    return std::find(table_[hash].begin(), table_[hash].end(), key) != table_[hash].end();
+    return FindKey(key);
+  }
+
+  template <class K, class = EnableIfTransparent<Hash, KeyEqual, K>>
+  bool Find(const K& key) const {
+    return FindKey(key);
   }
 
   bool Insert(const KeyT& key) {
-    if (Find(key)) {
+    return InsertKey(key);
+  }
+
+  bool Insert(KeyT&& key) {
+    return InsertKey(std::move(key));
+  }
+
+  // Returns false and leaves the node in the handle when the key is already present
+  bool Insert(NodeHandle&& node) {
+    if (node.Empty()) {
       return false;
     }
-    if (BucketCount() == 0) {
-      Reserve(1);
+    if (node.list_.get_allocator() != NodeAllocator(alloc_)) {
+      if (!InsertKey(std::move(node.Value()))) {
+        return false;
+      }
+      node.list_.clear();
+      return true;
     }
-    if (LoadFactor() >= kMaxLoadFactor) {
-      Reserve(Size() * 2);
+    return InsertNode(node.list_);
+  }
+
+  // The key is constructed once, directly inside its node; a duplicate costs that node but never a copy
+  template <class... Args>
+  bool Emplace(Args&&... args) {
+    List staging{NodeAllocator(alloc_)};
+    staging.emplace_back(0, std::forward<Args>(args)...);
+    return InsertNode(staging);
+  }
+
+  NodeHandle Extract(const KeyT& key) {
+    return ExtractKey(key);
+  }
+
+  template <class K, class = EnableIfTransparent<Hash, KeyEqual, K>>
+  NodeHandle Extract(const K& key) {
+    return ExtractKey(key);
+  }
+
+  // Moves every node whose key is missing here out of other; keys present in both stay in other
+  void Merge(UnorderedSet& other) {
+    if (this == &other) {
+      return;
+    }
+    bool same_allocator = NodeAllocator(alloc_) == NodeAllocator(other.alloc_);
+    for (Table* table : {&other.table_, &other.old_table_}) {
+      for (auto& bucket : *table) {
+        for (auto it = bucket.begin(); it != bucket.end();) {
+          auto next = std::next(it);
+          size_t hash = MergeHash(*it);
+          if (!Contains(it->key, hash)) {
+            if (same_allocator) {
+              SetCachedHash(*it, hash);
+              List& target = PrepareBucket(hash);
+              target.splice(target.end(), bucket, it);
+              ++n_elements_;
+            } else {
+              InsertKey(std::move(it->key));
+              bucket.erase(it);
+            }
+            --other.n_elements_;
+          }
+          it = next;
+        }
+      }
     }
-    size_t index = Hash(key);
-    table_[index].push_back(key);
-    ++n_elements_;
-    return true;
   }
 
-  bool Insert(KeyT&& key) {
-    return Insert(std::as_const(key));
+  void Merge(UnorderedSet&& other) {
+    Merge(other);
   }
 
   bool Erase(const KeyT& key) {
-    auto& bucket = table_[Hash(key)];
-    auto it = std::find(bucket.begin(), bucket.end(), key);
-    if (it != bucket.end()) {
-      bucket.erase(it);
-      --n_elements_;
-      return true;
+    return EraseKey(key);
+  }
+
+  template <class K, class = EnableIfTransparent<Hash, KeyEqual, K>>
+  bool Erase(const K& key) {
+    return EraseKey(key);
+  }
+
+  // With a non-zero step, growth only reserves the bigger bucket array. Every Insert/Erase/Extract then does at most
+  // buckets_per_step units of work: first building the new buckets, as many per unit as one old bucket splits into,
+  // then moving one old bucket into them per unit. No single operation pays for the whole rehash
+  void SetIncrementalRehash(size_t buckets_per_step) {
+    rehash_step_ = buckets_per_step;
+    if (rehash_step_ == 0) {
+      FinishMigration();
     }
-    return false;
+  }
+
+  bool Rehashing() const {
+    return !old_table_.empty();
   }
 
   void Rehash(size_t new_bucket_count) {
+    FinishMigration();
     if (new_bucket_count < n_elements_) {
       return;
     }
-    std::vector<std::list<KeyT>> new_buckets(new_bucket_count);
-    for (const auto& bucket : table_) {
-      for (const auto& elem : bucket) {
-        size_t new_index = std::hash<KeyT>{}(elem) % new_bucket_count;
-        new_buckets[new_index].push_back(elem);
+    new_bucket_count = NormalizeBucketCount(new_bucket_count);
+    Table new_buckets = MakeTable(new_bucket_count);
+    for (auto& bucket : table_) {
+      while (!bucket.empty()) {
+        auto& target = new_buckets[Index(NodeHash(bucket.front()), new_bucket_count)];
+        target.splice(target.end(), bucket, bucket.begin());
       }
     }
     table_.swap(new_buckets);
@@ -151,12 +436,332 @@ class UnorderedSet {
     Rehash(new_bucket_count);
   }
 
+  // Visits every key bucket by bucket, in the order the bucket array is laid out
+  template <class F>
+  void ForEach(F&& visit) const {
+    for (const Table* table : {&table_, &old_table_}) {
+      for (const auto& bucket : *table) {
+        for (const auto& node : bucket) {
+          visit(node.key);
+        }
+      }
+    }
+  }
+
+  // Same walk as ForEach, but requests the first node of the bucket `distance` positions ahead before visiting
+  // the current one, so the node fetches overlap with the visits
+  template <class F>
+  void ForEachPrefetched(F&& visit, size_t distance = kPrefetchDistance) const {
+    for (const Table* table : {&table_, &old_table_}) {
+      for (size_t i = 0; i < table->size(); ++i) {
+        if (i + distance < table->size() && !(*table)[i + distance].empty()) {
+          __builtin_prefetch(&(*table)[i + distance].front());
+        }
+        for (const auto& node : (*table)[i]) {
+          visit(node.key);
+        }
+      }
+    }
+  }
+
+  // Iterators
+  ConstIterator begin() const {  // NOLINT
+    return ConstIterator(&table_, &old_table_);
+  }
+
+  ConstIterator end() const {  // NOLINT
+    return ConstIterator();
+  }
+
+  ConstIterator cbegin() const {  // NOLINT
+    return begin();
+  }
+
+  ConstIterator cend() const {  // NOLINT
+    return end();
+  }
+
+  // Bulk insert: the table is sized once for the whole batch, keys are hashed in parallel and scattered by bucket
+  // range so each range of buckets is filled in one pass. Duplicates (in the batch or already present) are skipped.
+  // Returns the number of inserted keys
+  template <typename It>
+  size_t InsertRange(It begin, It end) {
+    Buffer<KeyT> keys(begin, end, Rebound<KeyT>(alloc_));
+    if (keys.empty()) {
+      return 0;
+    }
+    FinishMigration();
+    Reserve(std::max(n_elements_ + keys.size(), BucketCount()));
+    Buffer<size_t> hashes = HashAll(keys);
+
+    size_t partitions = std::min(kBulkPartitions, BucketCount());
+    size_t buckets_per_partition = (BucketCount() + partitions - 1) / partitions;
+    Buffer<size_t> offsets(partitions + 1, 0, Rebound<size_t>(alloc_));
+    for (size_t hash : hashes) {
+      ++offsets[Index(hash, BucketCount()) / buckets_per_partition + 1];
+    }
+    for (size_t i = 0; i < partitions; ++i) {
+      offsets[i + 1] += offsets[i];
+    }
+    Buffer<size_t> order(keys.size(), Rebound<size_t>(alloc_));
+    for (size_t i = 0; i < keys.size(); ++i) {
+      order[offsets[Index(hashes[i], BucketCount()) / buckets_per_partition]++] = i;
+    }
+
+    size_t inserted = 0;
+    for (size_t i : order) {
+      auto& bucket = table_[Index(hashes[i], BucketCount())];
+      if (FindIn(bucket, keys[i], hashes[i]) == bucket.end()) {
+        bucket.emplace_back(hashes[i], std::move(keys[i]));
+        ++n_elements_;
+        ++inserted;
+      }
+    }
+    return inserted;
+  }
+
  private:
-  std::vector<std::list<KeyT>> table_;
+  Hash hasher_;
+  KeyEqual key_equal_;
+  Allocator alloc_;
+  Table table_;
+  Table old_table_;
   size_t n_elements_ = 0;
+  size_t old_bucket_count_ = 0;
+  size_t pending_buckets_ = 0;
+  size_t rehash_step_ = 0;
+
+  template <class K>
+  size_t FullHash(const K& val) const {
+    if constexpr (Policy::kPowerOfTwo) {
+      return MixHash(hasher_(val));
+    } else {
+      return hasher_(val);
+    }
+  }
+
+  static size_t Index(size_t hash, size_t bucket_count) {
+    if constexpr (Policy::kPowerOfTwo) {
+      return hash & (bucket_count - 1);
+    } else {
+      return hash % bucket_count;
+    }
+  }
+
+  static size_t NormalizeBucketCount(size_t count) {
+    if constexpr (Policy::kPowerOfTwo) {
+      size_t normalized = 1;
+      while (normalized < count) {
+        normalized <<= 1;
+      }
+      return count == 0 ? 0 : normalized;
+    } else {
+      return count;
+    }
+  }
+
+  static void SetCachedHash([[maybe_unused]] Node& node, [[maybe_unused]] size_t hash) {
+    if constexpr (Policy::kCacheHash) {
+      node.hash = hash;
+    }
+  }
+
+  // Hashes on the shared ThreadPool; an exception thrown by the hasher on any thread is rethrown here
+  Buffer<size_t> HashAll(const Buffer<KeyT>& keys) const {
+    Buffer<size_t> hashes(keys.size(), Rebound<size_t>(alloc_));
+    DefaultThreadPool().ParallelFor(keys.size(), kParallelHashThreshold, [&](size_t from, size_t to) {
+      for (size_t i = from; i < to; ++i) {
+        hashes[i] = FullHash(keys[i]);
+      }
+    });
+    return hashes;
+  }
+
+  size_t NodeHash(const Node& node) const {
+    if constexpr (Policy::kCacheHash) {
+      return node.hash;
+    } else {
+      return FullHash(node.key);
+    }
+  }
+
+  // A hash cached by another set is only reused when the hasher is stateless; seeded hashers hash differently
+  size_t MergeHash(const Node& node) const {
+    if constexpr (std::is_empty_v<Hash>) {
+      return NodeHash(node);
+    } else {
+      return FullHash(node.key);
+    }
+  }
+
+  template <class Bucket, class K>
+  auto FindIn(Bucket& bucket, const K& key, [[maybe_unused]] size_t hash) const {
+    return std::find_if(bucket.begin(), bucket.end(), [&](const Node& node) {
+      if constexpr (Policy::kCacheHash) {
+        return node.hash == hash && key_equal_(node.key, key);
+      } else {
+        return key_equal_(node.key, key);
+      }
+    });
+  }
+
+  // Every bucket list gets its own copy of the allocator, so nodes can be spliced between any two of them
+  Table MakeTable(size_t bucket_count) const {
+    Table table(alloc_);
+    table.reserve(bucket_count);
+    for (size_t i = 0; i < bucket_count; ++i) {
+      table.emplace_back(NodeAllocator(alloc_));
+    }
+    return table;
+  }
+
+  template <class K>
+  size_t BucketIndex(const K& val) const {
+    return BucketCount() != 0 ? Index(FullHash(val), BucketCount()) : 0;
+  }
+
+  template <class K>
+  bool Contains(const K& key, size_t hash) const {
+    if (BucketCount() == 0) {
+      return false;
+    }
+    const auto& bucket = BucketOf(hash);
+    return FindIn(bucket, key, hash) != bucket.end();
+  }
+
+  template <class K>
+  bool FindKey(const K& key) const {
+    return Contains(key, FullHash(key));
+  }
+
+  // Grows the table if needed and returns the bucket a new element with this hash goes to
+  List& PrepareBucket(size_t hash) {
+    if (BucketCount() == 0) {
+      Reserve(1);
+    }
+    if (LoadFactor() >= kMaxLoadFactor) {
+      Grow();
+    }
+    return BucketOf(hash);
+  }
+
+  template <class K>
+  bool InsertKey(K&& key) {
+    size_t hash = FullHash(key);
+    if (Contains(key, hash)) {
+      return false;
+    }
+    PrepareBucket(hash).emplace_back(hash, std::forward<K>(key));
+    ++n_elements_;
+    MigrateStep();
+    return true;
+  }
+
+  // Relinks the single node of staging into its bucket unless its key is already present
+  bool InsertNode(List& staging) {
+    Node& node = staging.front();
+    size_t hash = FullHash(node.key);
+    if (Contains(node.key, hash)) {
+      return false;
+    }
+    SetCachedHash(node, hash);
+    List& bucket = PrepareBucket(hash);
+    bucket.splice(bucket.end(), staging, staging.begin());
+    ++n_elements_;
+    MigrateStep();
+    return true;
+  }
+
+  template <class K>
+  NodeHandle ExtractKey(const K& key) {
+    NodeHandle handle{List(NodeAllocator(alloc_))};
+    if (BucketCount() == 0) {
+      return handle;
+    }
+    size_t hash = FullHash(key);
+    auto& bucket = BucketOf(hash);
+    auto it = FindIn(bucket, key, hash);
+    if (it != bucket.end()) {
+      handle.list_.splice(handle.list_.end(), bucket, it);
+      --n_elements_;
+      MigrateStep();
+    }
+    return handle;
+  }
+
+  template <class K>
+  bool EraseKey(const K& key) {
+    if (BucketCount() == 0) {
+      return false;
+    }
+    size_t hash = FullHash(key);
+    auto& bucket = BucketOf(hash);
+    auto it = FindIn(bucket, key, hash);
+    if (it != bucket.end()) {
+      bucket.erase(it);
+      --n_elements_;
+      MigrateStep();
+      return true;
+    }
+    return false;
+  }
+
+  // Old buckets are drained from the back and popped, so a key whose old bucket is gone already lives in the new
+  // table and a key lives in exactly one of the two. While the new table is being built none has been popped
+  List& BucketOf(size_t hash) {
+    if (Rehashing()) {
+      size_t old_index = Index(hash, old_bucket_count_);
+      if (old_index < old_table_.size()) {
+        return old_table_[old_index];
+      }
+    }
+    return table_[Index(hash, table_.size())];
+  }
+
+  const List& BucketOf(size_t hash) const {
+    return const_cast<UnorderedSet*>(this)->BucketOf(hash);
+  }
+
+  void Grow() {
+    if (rehash_step_ == 0) {
+      Reserve(Size() * 2);
+      return;
+    }
+    FinishMigration();
+    size_t new_bucket_count = NormalizeBucketCount(Size() * 2);
+    old_table_.swap(table_);
+    // Reserving allocates without constructing a single bucket; MigrateStep builds them a few at a time
+    table_ = Table(alloc_);
+    table_.reserve(new_bucket_count);
+    pending_buckets_ = new_bucket_count;
+    old_bucket_count_ = old_table_.size();
+  }
+
+  void MigrateStep() {
+    for (size_t moved = 0; moved < rehash_step_ && Rehashing(); ++moved) {
+      if (pending_buckets_ != 0) {
+        size_t build = std::min(pending_buckets_, (BucketCount() + old_bucket_count_ - 1) / old_bucket_count_);
+        for (size_t i = 0; i < build; ++i) {
+          table_.emplace_back(NodeAllocator(alloc_));
+        }
+        pending_buckets_ -= build;
+        continue;
+      }
+      // Popping each drained bucket spreads the destruction of the old table over the migration too
+      auto& bucket = old_table_.back();
+      while (!bucket.empty()) {
+        auto& target = table_[Index(NodeHash(bucket.front()), table_.size())];
+        target.splice(target.end(), bucket, bucket.begin());
+      }
+      old_table_.pop_back();
+    }
+  }
 
-  size_t Hash(const KeyT& val) const {
-    return !table_.empty() ? std::hash<KeyT>{}(val) % table_.size() : 0;
+  void FinishMigration() {
+    size_t step = rehash_step_;
+    rehash_step_ = std::numeric_limits<size_t>::max();
+    MigrateStep();
+    rehash_step_ = step;
   }
 };
 
@@ -3,16 +3,73 @@
 
 #define VECTOR_MEMORY_IMPLEMENTED
 
+#include <algorithm>
 #include <cstdlib>
+#include <cstring>
 #include <initializer_list>
 #include <iterator>
 #include <utility>
 #include <utility>
 #include <memory>
+#include <stdexcept>
+#include <type_traits>
 
+#include "range_compare.h"
+#include "vector_stats.h"
+
+// Types whose objects may be moved to new storage by copying their bytes and forgetting the source. Trivially
+// copyable types qualify; specialize to opt in others whose move plus destroy amounts to a memcpy (most types that
+// own heap memory through a plain pointer)
 template <class T>
-class Vector {
+struct IsTriviallyRelocatable : std::is_trivially_copyable<T> {};
+
+template <class Allocator, class T, class = void>
+struct HasReallocate : std::false_type {};
+
+template <class Allocator, class T>
+struct HasReallocate<Allocator, T,
+                     std::void_t<decltype(std::declval<Allocator&>().reallocate(std::declval<T*>(), 0, 0))>>
+    : std::true_type {};
+
+template <class It>
+using EnableIfForwardIterator = std::enable_if_t<
+    std::is_base_of_v<std::forward_iterator_tag, typename std::iterator_traits<It>::iterator_category>>;
+
+const float kDefaultGrowthFactor = 2;
+
+// Tag selecting default-initialization: new elements of trivial types are left uninitialized instead of zeroed
+struct DefaultInit {
+  explicit DefaultInit() = default;
+};
+
+inline constexpr DefaultInit kDefaultInit{};
+
+// Inline element storage of a Vector<T, N>; empty for N == 0, so plain vectors pay nothing for it
+template <class T, size_t N>
+class VectorInlineBuffer {
+ protected:
+  T* InlineData() {
+    return reinterpret_cast<T*>(buffer_);
+  }
+
+ private:
+  alignas(T) unsigned char buffer_[N * sizeof(T)];
+};
+
+template <class T>
+class VectorInlineBuffer<T, 0> {
+ protected:
+  T* InlineData() {
+    return nullptr;
+  }
+};
+
+// Up to N elements live inside the object itself; storage past N comes from Allocator. Stats receives allocation,
+// growth and relocation events (see vector_stats.h); the default policy ignores them
+template <class T, size_t N = 0, class Allocator = std::allocator<T>, class Stats = NoVectorStats>
+class Vector : private VectorInlineBuffer<T, N> {
  public:
+  using AllocatorType = Allocator;
   using ValueType = T;
   using Pointer = T*;
   using ConstPointer = const T*;
@@ -24,14 +81,16 @@ class Vector {
   using ReverseIterator = std::reverse_iterator<Iterator>;
   using ConstReverseIterator = std::reverse_iterator<ConstIterator>;
 
-  const int kExpandCf = 2;
-
   // Main constructors
-  Vector() : store_(nullptr), size_(0), capacity_(0){};
+  Vector() : store_(this->InlineData()), size_(0), capacity_(N){};
+
+  explicit Vector(const Allocator& alloc) : alloc_(alloc), store_(this->InlineData()), size_(0), capacity_(N) {
+  }
 
-  explicit Vector(size_t size) : size_(size), capacity_(size) {
+  explicit Vector(size_t size, const Allocator& alloc = Allocator())
+      : alloc_(alloc), size_(size), capacity_(std::max(size, N)) {
     if (size == 0) {
-      store_ = nullptr;
+      store_ = this->InlineData();
       return;
     }
     store_ = Allocate(size);
@@ -41,15 +100,31 @@ class Vector {
       } catch (...) {
         Deallocate(i);
         size_ = 0;
-        capacity_ = 0;
+        capacity_ = N;
         throw;
       }
     }
   }
 
-  Vector(const size_t size, const T& value) : size_(size), capacity_(size) {
+  Vector(size_t size, DefaultInit, const Allocator& alloc = Allocator())
+      : alloc_(alloc), size_(size), capacity_(std::max(size, N)) {
+    store_ = Allocate(size);
+    for (size_t i = 0; i < size; ++i) {
+      try {
+        new (store_ + i) T;
+      } catch (...) {
+        Deallocate(i);
+        size_ = 0;
+        capacity_ = N;
+        throw;
+      }
+    }
+  }
+
+  Vector(const size_t size, const T& value, const Allocator& alloc = Allocator())
+      : alloc_(alloc), size_(size), capacity_(std::max(size, N)) {
     if (size == 0) {
-      store_ = nullptr;
+      store_ = this->InlineData();
       return;
     }
     store_ = Allocate(size);
@@ -59,31 +134,30 @@ class Vector {
       } catch (...) {
         Deallocate(i);
         size_ = 0;
-        capacity_ = 0;
+        capacity_ = N;
         throw;
       }
     }
   }
 
-  template <class Iterator, class = std::enable_if_t<std::is_base_of_v<
-      std::forward_iterator_tag, typename std::iterator_traits<Iterator>::iterator_category>>>
-  Vector(Iterator first, Iterator last) {
-    store_ = nullptr;
-    size_ = 0;
-    capacity_ = 0;
+  // The range is measured first, so the elements are built in a single allocation
+  template <class Iterator, class = EnableIfForwardIterator<Iterator>>
+  Vector(Iterator first, Iterator last, const Allocator& alloc = Allocator()) : alloc_(alloc), size_(0) {
+    auto count = static_cast<size_t>(std::distance(first, last));
+    capacity_ = std::max(count, N);
+    store_ = Allocate(count);
     try {
-      for (auto it = first; it != last; it++) {
-        PushBack(*it);
-      }
+      ConstructRange(first, count, store_);
     } catch (...) {
-      Deallocate(size_);
-      size_ = 0;
-      capacity_ = 0;
+      Deallocate(0);
+      capacity_ = N;
       throw;
     }
+    size_ = count;
   }
 
-  Vector(std::initializer_list<T> init) : size_(init.size()), capacity_(init.size()) {
+  Vector(std::initializer_list<T> init, const Allocator& alloc = Allocator())
+      : alloc_(alloc), size_(init.size()), capacity_(std::max(init.size(), N)) {
     store_ = Allocate(size_);
     size_t padding = 0;
     for (auto it = init.begin(); it != init.end(); ++it) {
@@ -92,32 +166,51 @@ class Vector {
       } catch (...) {
         Deallocate(padding - 1);
         size_ = 0;
-        capacity_ = 0;
+        capacity_ = N;
         throw;
       }
     }
   }
 
-  // Copy constructor
-  Vector(const Vector<T>& copy) : size_(copy.size_), capacity_(copy.capacity_) {
-    store_ = Allocate(copy.capacity_);
+  // Copy constructor: the copy is sized to the elements, not to the source's spare capacity
+  Vector(const Vector& copy)
+      : alloc_(AllocTraits::select_on_container_copy_construction(copy.alloc_)),
+        size_(copy.size_),
+        capacity_(std::max(copy.size_, N)),
+        growth_factor_(copy.growth_factor_) {
+    store_ = Allocate(copy.size_);
+    if constexpr (std::is_trivially_copyable_v<T>) {
+      CopyBytes(copy.store_, size_, store_);
+      return;
+    }
     for (size_t i = 0; i < size_; ++i) {
       try {
         new (store_ + i) T(copy.At(i));
       } catch (...) {
         Deallocate(i);
         size_ = 0;
-        capacity_ = 0;
+        capacity_ = N;
         throw;
       }
     }
   }
 
-  // Move constructor
-  Vector(Vector<T>&& move) noexcept : store_(move.store_), size_(move.size_), capacity_(move.capacity_) {
-    move.store_ = nullptr;
+  // Move constructor: heap storage changes owner, inline elements are moved one by one
+  Vector(Vector&& move) noexcept(kNothrowRelocate)
+      : alloc_(std::move(move.alloc_)),
+        store_(move.store_),
+        size_(move.size_),
+        capacity_(move.capacity_),
+        growth_factor_(move.growth_factor_) {
+    if (move.IsInline()) {
+      store_ = this->InlineData();
+      Relocate(move.store_, size_, store_);
+      move.size_ = 0;
+      return;
+    }
+    move.store_ = move.InlineData();
     move.size_ = 0;
-    move.capacity_ = 0;
+    move.capacity_ = N;
   }
 
   // Destructor
@@ -126,21 +219,28 @@ class Vector {
   }
 
   // Copy assignment operator
-  Vector<T>& operator=(const Vector<T>& copy) {
+  Vector& operator=(const Vector& copy) {
     if (this == &copy) {
       return *this;
     }
     Deallocate(size_);
+    if constexpr (AllocTraits::propagate_on_container_copy_assignment::value) {
+      alloc_ = copy.alloc_;
+    }
     size_ = copy.size_;
-    capacity_ = copy.capacity_;
+    capacity_ = std::max(size_, N);
     store_ = Allocate(size_);
+    if constexpr (std::is_trivially_copyable_v<T>) {
+      CopyBytes(copy.store_, size_, store_);
+      return *this;
+    }
     for (size_t i = 0; i < size_; ++i) {
       try {
         new (store_ + i) T(copy[i]);
       } catch (...) {
         Deallocate(i);
         size_ = 0;
-        capacity_ = 0;
+        capacity_ = N;
         throw;
       }
     }
@@ -148,17 +248,38 @@ class Vector {
   }
 
   // Move assignment operator
-  Vector<T>& operator=(Vector<T>&& move) noexcept {
+  // Storage is only taken over when this allocator can free it; otherwise the elements are moved one by one
+  Vector& operator=(Vector&& move) noexcept(kNothrowRelocate && kStealOnMove) {
     if (this == &move) {
       return *this;
     }
+    if constexpr (!kStealOnMove) {
+      if (alloc_ != move.alloc_) {
+        *this = Vector(std::make_move_iterator(move.begin()), std::make_move_iterator(move.end()), alloc_);
+        growth_factor_ = move.growth_factor_;
+        move.Clear();
+        return *this;
+      }
+    }
     Deallocate(size_);
+    if constexpr (AllocTraits::propagate_on_container_move_assignment::value) {
+      alloc_ = std::move(move.alloc_);
+    }
+    growth_factor_ = move.growth_factor_;
+    if (move.IsInline()) {
+      size_ = 0;
+      capacity_ = N;
+      Relocate(move.store_, move.size_, store_);
+      size_ = move.size_;
+      move.size_ = 0;
+      return *this;
+    }
     store_ = move.store_;
     size_ = move.size_;
     capacity_ = move.capacity_;
-    move.store_ = nullptr;
+    move.store_ = move.InlineData();
     move.size_ = 0;
-    move.capacity_ = 0;
+    move.capacity_ = N;
     return *this;
   }
 
@@ -228,10 +349,36 @@ class Vector {
     size_ = 0;
   }
 
-  void Swap(Vector<T>& other) {
+  Allocator GetAllocator() const {
+    return alloc_;
+  }
+
+  float GrowthFactor() const {
+    return growth_factor_;
+  }
+
+  // Capacity is multiplied by this factor whenever an insertion finds the vector full
+  void SetGrowthFactor(float factor) {
+    if (!(factor > 1)) {
+      throw std::invalid_argument("Growth factor must exceed 1");
+    }
+    growth_factor_ = factor;
+  }
+
+  void Swap(Vector& other) {
+    if (IsInline() || other.IsInline()) {
+      Vector tmp(std::move(other));
+      other = std::move(*this);
+      *this = std::move(tmp);
+      return;
+    }
+    if constexpr (AllocTraits::propagate_on_container_swap::value) {
+      std::swap(alloc_, other.alloc_);
+    }
     std::swap(size_, other.size_);
     std::swap(capacity_, other.capacity_);
     std::swap(store_, other.store_);
+    std::swap(growth_factor_, other.growth_factor_);
   }
 
   void Resize(size_t new_size) {
@@ -242,6 +389,9 @@ class Vector {
       }
       return;
     }
+    if constexpr (kReallocates) {
+      Reserve(new_size);
+    }
     if (new_size <= capacity_) {
       for (size_t i = size_; i < new_size; ++i) {
         try {
@@ -260,14 +410,12 @@ class Vector {
         new (new_store + i) T();
       } catch (...) {
         std::destroy_n(new_store + size_, i - size_);
-        auto void_ptr = static_cast<void*>(new_store);
-        auto align = static_cast<std::align_val_t>(alignof(T));
-        ::operator delete(void_ptr, align);
+        Free(new_store, new_size);
         throw;
       }
     }
-    std::uninitialized_move_n(store_, size_, new_store);
-    Deallocate(size_);
+    Stats::template OnGrow<Vector>(capacity_, new_size);
+    RelocateTo(new_store, size_);
     store_ = new_store;
     capacity_ = new_size;
     size_ = new_size;
@@ -281,6 +429,9 @@ class Vector {
       }
       return;
     }
+    if constexpr (kReallocates) {
+      Reserve(new_size);
+    }
     if (new_size <= capacity_) {
       for (size_t i = size_; i < new_size; ++i) {
         try {
@@ -299,52 +450,117 @@ class Vector {
         new (new_store + i) T(value);
       } catch (...) {
         std::destroy_n(new_store + size_, i - size_);
-        auto void_ptr = static_cast<void*>(new_store);
-        auto align = static_cast<std::align_val_t>(alignof(T));
-        ::operator delete(void_ptr, align);
+        Free(new_store, new_size);
         throw;
       }
     }
-    std::uninitialized_move_n(store_, size_, new_store);
-    Deallocate(size_);
+    Stats::template OnGrow<Vector>(capacity_, new_size);
+    RelocateTo(new_store, size_);
     store_ = new_store;
     capacity_ = new_size;
     size_ = new_size;
   }
 
+  // Like Resize, but new elements are default-initialized: trivial types keep whatever bytes the storage held
+  void ResizeDefaultInit(size_t new_size) {
+    if (new_size <= size_) {
+      std::destroy_n(store_ + new_size, size_ - new_size);
+      size_ = new_size;
+      return;
+    }
+    Reserve(new_size);
+    for (size_t i = size_; i < new_size; ++i) {
+      try {
+        new (store_ + i) T;
+      } catch (...) {
+        std::destroy_n(store_ + size_, i - size_);
+        throw;
+      }
+    }
+    size_ = new_size;
+  }
+
+  // Only moves the size: new elements are uninitialized and must be written before they are read
+  void ResizeUninitialized(size_t new_size) {
+    static_assert(std::is_trivially_default_constructible_v<T> && std::is_trivially_destructible_v<T>,
+                  "ResizeUninitialized needs a trivial element type; use ResizeDefaultInit");
+    Reserve(new_size);
+    size_ = new_size;
+  }
+
+  // Lets `fill(T* dest, size_t n)` write up to n elements straight into spare capacity after the last element.
+  // If fill returns a count, only that many are appended; if it throws, the size is unchanged
+  template <class F>
+  void AppendWith(size_t n, F&& fill) {
+    static_assert(std::is_trivially_default_constructible_v<T> && std::is_trivially_destructible_v<T>,
+                  "AppendWith writes raw storage, so it needs a trivial element type");
+    if (size_ + n > capacity_) {
+      Reserve(std::max(size_ + n, NextCapacity()));
+    }
+    if constexpr (std::is_void_v<std::invoke_result_t<F&, T*, size_t>>) {
+      fill(store_ + size_, n);
+      size_ += n;
+    } else {
+      size_t written = fill(store_ + size_, n);
+      size_ += std::min(static_cast<size_t>(written), n);
+    }
+  }
+
   void Reserve(size_t new_cap) {
     if (new_cap <= capacity_) {
       return;
     }
+    if constexpr (kReallocates) {
+      if (new_cap > N && !IsInline() && store_ != nullptr) {
+        store_ = alloc_.reallocate(store_, capacity_, new_cap);
+        Stats::template OnAllocate<Vector>(new_cap);
+        Stats::template OnGrow<Vector>(capacity_, new_cap);
+        capacity_ = new_cap;
+        return;
+      }
+    }
     T* new_store = Allocate(new_cap);
+    Stats::template OnGrow<Vector>(capacity_, new_cap);
     if (store_ != nullptr) {
-      std::uninitialized_move_n(store_, size_, new_store);
-      Deallocate(size_);
+      RelocateTo(new_store, size_);
     }
     capacity_ = new_cap;
     store_ = new_store;
   }
 
+  // Also moves a spilled vector back into its inline buffer once it fits there again
   void ShrinkToFit() {
-    if (capacity_ == 0) {
+    if (capacity_ == N) {
       return;
     }
     if (size_ == 0) {
       Deallocate(size_);
-      capacity_ = 0;
-      store_ = nullptr;
+      capacity_ = N;
       return;
     }
+    if constexpr (kReallocates) {
+      if (size_ > N) {
+        store_ = alloc_.reallocate(store_, capacity_, size_);
+        Stats::template OnAllocate<Vector>(size_);
+        capacity_ = size_;
+        return;
+      }
+    }
     T* shrink_store = Allocate(size_);
-    std::uninitialized_move_n(store_, size_, shrink_store);
-    Deallocate(size_);
-    capacity_ = size_;
+    RelocateTo(shrink_store, size_);
+    capacity_ = std::max(size_, N);
     store_ = shrink_store;
   }
 
   void PushBack(const T& value) {
+    if constexpr (kReallocates) {
+      if (size_ == capacity_) {
+        GrowAndAppend(value);
+        return;
+      }
+    }
     T* new_store = nullptr;
-    auto new_capacity = capacity_ == 0 ? 1 : kExpandCf * capacity_;
+    auto new_capacity = NextCapacity();
     if (size_ == capacity_) {
       new_store = Allocate(new_capacity);
     } else {
@@ -354,16 +570,14 @@ class Vector {
       new (new_store + size_) T(value);
       ++size_;
       if (new_store != store_) {
-        std::uninitialized_move_n(store_, size_ - 1, new_store);
-        Deallocate(size_ - 1);
+        Stats::template OnGrow<Vector>(capacity_, new_capacity);
+        RelocateTo(new_store, size_ - 1);
         store_ = new_store;
         capacity_ = new_capacity;
       }
     } catch (...) {
       if (new_store != store_) {
-        auto void_ptr = static_cast<void*>(new_store);
-        auto align = static_cast<std::align_val_t>(alignof(T));
-        ::operator delete(void_ptr, align);
+        Free(new_store, new_capacity);
       }
       throw;
     }
@@ -371,7 +585,7 @@ class Vector {
 
   void PushBack(T&& value) {
     if (size_ == capacity_) {
-      Reserve(capacity_ == 0 ? 1 : capacity_ * kExpandCf);
+      Reserve(NextCapacity());
     }
     try {
       new (store_ + size_) T(std::forward<T&&>(value));
@@ -382,8 +596,14 @@ class Vector {
 
   template <typename... Args>
   void EmplaceBack(Args&&... args) {
+    if constexpr (kReallocates) {
+      if (size_ == capacity_) {
+        GrowAndAppend(std::forward<Args>(args)...);
+        return;
+      }
+    }
     T* new_store = nullptr;
-    auto new_cap = capacity_ == 0 ? 1 : kExpandCf * capacity_;
+    auto new_cap = NextCapacity();
     if (size_ == capacity_) {
       new_store = Allocate(new_cap);
     } else {
@@ -393,16 +613,14 @@ class Vector {
       new (new_store + size_) T(std::forward<Args&&>(args)...);
       ++size_;
       if (new_store != store_) {
-        std::uninitialized_move_n(store_, size_ - 1, new_store);
-        Deallocate(size_ - 1);
+        Stats::template OnGrow<Vector>(capacity_, new_cap);
+        RelocateTo(new_store, size_ - 1);
         store_ = new_store;
         capacity_ = new_cap;
       }
     } catch (...) {
       if (new_store != store_) {
-        auto void_ptr = static_cast<void*>(new_store);
-        auto align = static_cast<std::align_val_t>(alignof(T));
-        ::operator delete(void_ptr, align);
+        Free(new_store, new_cap);
       }
       throw;
     }
@@ -416,17 +634,89 @@ class Vector {
     size_--;
   }
 
-  // Compare operators
-  friend bool operator==(const Vector& left, const Vector& right) {
-    if (left.Size() != right.Size()) {
-      return false;
+  // Range operations. Each one sizes its result once: at most one allocation, and the tail after the insertion
+  // point is relocated once (with memmove for trivially relocatable types). A range passed to Insert or Assign
+  // must not point into this vector; Append may take one that does
+  template <class It, class = EnableIfForwardIterator<It>>
+  void Append(It first, It last) {
+    auto count = static_cast<size_t>(std::distance(first, last));
+    InsertWith(size_, count, [&](T* dest) { ConstructRange(first, count, dest); });
+  }
+
+  void Append(std::initializer_list<T> init) {
+    Append(init.begin(), init.end());
+  }
+
+  template <class It, class = EnableIfForwardIterator<It>>
+  Iterator Insert(ConstIterator pos, It first, It last) {
+    auto count = static_cast<size_t>(std::distance(first, last));
+    return InsertWith(pos - begin(), count, [&](T* dest) { ConstructRange(first, count, dest); });
+  }
+
+  Iterator Insert(ConstIterator pos, std::initializer_list<T> init) {
+    return Insert(pos, init.begin(), init.end());
+  }
+
+  Iterator Insert(ConstIterator pos, size_t count, const T& value) {
+    T copy(value);
+    return InsertWith(pos - begin(), count, [&](T* dest) { std::uninitialized_fill_n(dest, count, copy); });
+  }
+
+  Iterator Insert(ConstIterator pos, const T& value) {
+    return Emplace(pos, value);
+  }
+
+  Iterator Insert(ConstIterator pos, T&& value) {
+    return Emplace(pos, std::move(value));
+  }
+
+  // The element is built before anything moves, since `args` may refer into the vector
+  template <typename... Args>
+  Iterator Emplace(ConstIterator pos, Args&&... args) {
+    T value(std::forward<Args>(args)...);
+    return InsertWith(pos - begin(), 1, [&](T* dest) { new (dest) T(std::move(value)); });
+  }
+
+  Iterator Erase(ConstIterator pos) {
+    return Erase(pos, pos + 1);
+  }
+
+  Iterator Erase(ConstIterator first, ConstIterator last) {
+    size_t idx = first - begin();
+    size_t count = last - first;
+    if (count == 0) {
+      return begin() + idx;
     }
-    for (size_t i = 0; i < left.Size(); ++i) {
-      if (left[i] != right[i]) {
-        return false;
-      }
+    if constexpr (IsTriviallyRelocatable<T>::value) {
+      std::destroy_n(store_ + idx, count);
+      MoveBytes(store_ + idx + count, size_ - idx - count, store_ + idx);
+    } else {
+      std::move(store_ + idx + count, store_ + size_, store_ + idx);
+      std::destroy_n(store_ + size_ - count, count);
     }
-    return true;
+    size_ -= count;
+    return begin() + idx;
+  }
+
+  template <class It, class = EnableIfForwardIterator<It>>
+  void Assign(It first, It last) {
+    Clear();
+    Append(first, last);
+  }
+
+  void Assign(std::initializer_list<T> init) {
+    Assign(init.begin(), init.end());
+  }
+
+  void Assign(size_t count, const T& value) {
+    T copy(value);
+    Clear();
+    InsertWith(0, count, [&](T* dest) { std::uninitialized_fill_n(dest, count, copy); });
+  }
+
+  // Compare operators
+  friend bool operator==(const Vector& left, const Vector& right) {
+    return left.Size() == right.Size() && RangeEqual(left.Data(), right.Data(), left.Size());
   }
 
   friend bool operator!=(const Vector& left, const Vector& right) {
@@ -434,7 +724,7 @@ class Vector {
   }
 
   friend bool operator<(const Vector& left, const Vector& right) {
-    return std::lexicographical_compare(left.begin(), left.end(), right.begin(), right.end());
+    return RangeLess(left.Data(), left.Size(), right.Data(), right.Size());
   }
 
   friend bool operator<=(const Vector& left, const Vector& right) {
@@ -500,18 +790,135 @@ class Vector {
   }
 
  private:
+  using AllocTraits = std::allocator_traits<Allocator>;
+
+  static constexpr bool kNothrowRelocate =
+      N == 0 || IsTriviallyRelocatable<T>::value || std::is_nothrow_move_constructible_v<T>;
+  // Allocators with reallocate() (see mmap_allocator.h) grow the buffer in place for relocatable types
+  static constexpr bool kReallocates = IsTriviallyRelocatable<T>::value && HasReallocate<Allocator, T>::value;
+  static constexpr bool kStealOnMove =
+      AllocTraits::propagate_on_container_move_assignment::value || AllocTraits::is_always_equal::value;
+
+  // An empty allocator takes no space, so growth_factor_ fits in the tail padding and Vector<T> stays four words
+  [[no_unique_address]] Allocator alloc_;
   T* store_;
   size_t size_;
   size_t capacity_;
+  float growth_factor_ = kDefaultGrowthFactor;
+
+  bool IsInline() {
+    return N != 0 && store_ == this->InlineData();
+  }
 
+  // Requests of up to N elements are served by the inline buffer
   T* Allocate(size_t num) {
-    if (num == 0) {
-      return nullptr;
+    if (num <= N) {
+      return this->InlineData();
     }
-    auto total_memory = num * sizeof(T);
-    auto align = static_cast<std::align_val_t>(alignof(T));
-    auto void_ptr = ::operator new(total_memory, align);
-    return static_cast<T*>(void_ptr);
+    T* store = AllocTraits::allocate(alloc_, num);
+    Stats::template OnAllocate<Vector>(num);
+    return store;
+  }
+
+  void Free(T* store, size_t num) {
+    if (num > N) {
+      AllocTraits::deallocate(alloc_, store, num);
+    }
+  }
+
+  size_t NextCapacity() const {
+    auto grown = static_cast<size_t>(static_cast<double>(capacity_) * growth_factor_);
+    return std::max(grown, capacity_ + 1);
+  }
+
+  // The new element is built before the buffer moves, since `args` may refer into it
+  template <typename... Args>
+  void GrowAndAppend(Args&&... args) {
+    T value(std::forward<Args>(args)...);
+    Reserve(NextCapacity());
+    new (store_ + size_) T(std::move(value));
+    ++size_;
+  }
+
+  // Makes room for `count` elements at `idx` and has `construct` build all of them there, or none if it throws.
+  // Growing builds them in the new buffer before anything is relocated, so they may be copies of old elements.
+  // In place, types that are not trivially relocatable are built at the end and rotated into position; if a move
+  // assignment throws there, the vector keeps all its elements, in an unspecified order
+  template <class Construct>
+  Iterator InsertWith(size_t idx, size_t count, Construct&& construct) {
+    if (size_ + count > capacity_) {
+      size_t new_cap = std::max(size_ + count, NextCapacity());
+      T* new_store = Allocate(new_cap);
+      try {
+        construct(new_store + idx);
+      } catch (...) {
+        Free(new_store, new_cap);
+        throw;
+      }
+      Stats::template OnGrow<Vector>(capacity_, new_cap);
+      Relocate(store_, idx, new_store);
+      Relocate(store_ + idx, size_ - idx, new_store + idx + count);
+      Deallocate(0);
+      store_ = new_store;
+      capacity_ = new_cap;
+    } else if constexpr (IsTriviallyRelocatable<T>::value) {
+      MoveBytes(store_ + idx, size_ - idx, store_ + idx + count);
+      try {
+        construct(store_ + idx);
+      } catch (...) {
+        MoveBytes(store_ + idx + count, size_ - idx, store_ + idx);
+        throw;
+      }
+    } else {
+      construct(store_ + size_);
+      // The new elements count as ours before the rotate, so a throwing move assignment leaves every element
+      // inside [0, size_) and none of them leaks
+      size_ += count;
+      std::rotate(store_ + idx, store_ + size_ - count, store_ + size_);
+      return begin() + idx;
+    }
+    size_ += count;
+    return begin() + idx;
+  }
+
+  // Copies `count` elements from `first` into raw storage; memcpy when the source is contiguous trivial data
+  template <class It>
+  static void ConstructRange(It first, size_t count, T* dest) {
+    if constexpr (std::is_pointer_v<It> && std::is_same_v<std::remove_cv_t<std::remove_pointer_t<It>>, T> &&
+                  std::is_trivially_copyable_v<T>) {
+      CopyBytes(first, count, dest);
+    } else {
+      std::uninitialized_copy_n(first, count, dest);
+    }
+  }
+
+  static void MoveBytes(T* from, size_t count, T* to) {
+    if (count != 0) {
+      std::memmove(static_cast<void*>(to), static_cast<const void*>(from), count * sizeof(T));
+    }
+  }
+
+  static void CopyBytes(const T* from, size_t count, T* to) {
+    if (count != 0) {
+      std::memcpy(static_cast<void*>(to), static_cast<const void*>(from), count * sizeof(T));
+    }
+  }
+
+  // Leaves `to` holding the elements and `from` raw memory
+  static void Relocate(T* from, size_t count, T* to) {
+    Stats::template OnMove<Vector>(count);
+    if constexpr (IsTriviallyRelocatable<T>::value) {
+      CopyBytes(from, count, to);
+    } else {
+      std::uninitialized_move_n(from, count, to);
+      std::destroy_n(from, count);
+    }
+  }
+
+  // Relocates the first `count` elements into `new_store` and frees the old storage
+  void RelocateTo(T* new_store, size_t count) {
+    Relocate(store_, count, new_store);
+    Deallocate(0);
   }
 
   void Deallocate(size_t amount) {
@@ -519,10 +926,10 @@ class Vector {
       return;
     }
     std::destroy_n(store_, amount);
-    auto void_ptr = static_cast<void*>(store_);
-    auto align = static_cast<std::align_val_t>(alignof(T));
-    ::operator delete(void_ptr, align);
-    store_ = nullptr;
+    if (!IsInline()) {
+      Free(store_, capacity_);
+    }
+    store_ = this->InlineData();
   }
 };
 
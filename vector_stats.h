@@ -0,0 +1,158 @@
+#ifndef VECTOR_STATS_H_
+#define VECTOR_STATS_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <typeinfo>
+
+#ifdef __GNUG__
+#include <cxxabi.h>
+#endif
+
+// Counters shared by every vector of one instrumented Vector type. Updates are relaxed atomics, so vectors of the
+// same type may live on different threads
+struct VectorCounters {
+  VectorCounters(std::string type_name, size_t type_element_size)
+      : name(std::move(type_name)), element_size(type_element_size) {
+  }
+
+  std::string name;
+  size_t element_size;
+  // Heap buffers requested, including in-place reallocations, and their total size
+  std::atomic<uint64_t> allocations{0};
+  std::atomic<uint64_t> allocated_bytes{0};
+  // Capacity increases of an existing vector, from Reserve as well as from appends and inserts
+  std::atomic<uint64_t> growths{0};
+  // Elements relocated to another buffer; an in-place reallocation moves none
+  std::atomic<uint64_t> moved_elements{0};
+  // Largest capacity any one vector of the type has had, in elements
+  std::atomic<uint64_t> peak_capacity{0};
+
+  void Reset() {
+    allocations = 0;
+    allocated_bytes = 0;
+    growths = 0;
+    moved_elements = 0;
+    peak_capacity = 0;
+  }
+};
+
+// Process-wide list of VectorCounters, one per instrumented Vector type, filled on first use of each type
+class VectorStatsRegistry {
+ public:
+  static VectorStatsRegistry& Instance() {
+    static VectorStatsRegistry registry;
+    return registry;
+  }
+
+  // The returned counters live as long as the process
+  VectorCounters& Register(std::string name, size_t element_size) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return counters_.emplace_back(std::move(name), element_size);
+  }
+
+  template <class F>
+  void ForEach(F&& visit) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& counters : counters_) {
+      visit(counters);
+    }
+  }
+
+  void Reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& counters : counters_) {
+      counters.Reset();
+    }
+  }
+
+  // One line per type: name, element size and the counters in declaration order
+  void Dump(std::ostream& out) const {
+    ForEach([&out](const VectorCounters& counters) {
+      out << counters.name << ": element_size=" << counters.element_size
+          << " allocations=" << counters.allocations.load(std::memory_order_relaxed)
+          << " allocated_bytes=" << counters.allocated_bytes.load(std::memory_order_relaxed)
+          << " growths=" << counters.growths.load(std::memory_order_relaxed)
+          << " moved_elements=" << counters.moved_elements.load(std::memory_order_relaxed)
+          << " peak_capacity=" << counters.peak_capacity.load(std::memory_order_relaxed) << '\n';
+    });
+  }
+
+ private:
+  mutable std::mutex mutex_;
+  // A deque never moves its elements, so references handed out by Register stay valid
+  std::deque<VectorCounters> counters_;
+};
+
+template <class Type>
+std::string VectorTypeName() {
+  const char* name = typeid(Type).name();
+#ifdef __GNUG__
+  int status = 0;
+  char* demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+  if (status == 0 && demangled != nullptr) {
+    std::string result(demangled);
+    std::free(demangled);
+    return result;
+  }
+#endif
+  return name;
+}
+
+// Default Vector policy: every hook is empty, so an uninstrumented Vector compiles to the same code as before
+struct NoVectorStats {
+  template <class Owner>
+  static void OnAllocate(size_t) {
+  }
+
+  template <class Owner>
+  static void OnGrow(size_t, size_t) {
+  }
+
+  template <class Owner>
+  static void OnMove(size_t) {
+  }
+};
+
+// Counting policy: Vector<T, N, Allocator, CountVectorStats<>> reports to VectorStatsRegistry. Vectors that differ
+// only in Tag are counted apart, which lets a single call site be singled out
+template <class Tag = void>
+struct CountVectorStats {
+  template <class Owner>
+  static void OnAllocate(size_t elements) {
+    auto& counters = CountersOf<Owner>();
+    counters.allocations.fetch_add(1, std::memory_order_relaxed);
+    counters.allocated_bytes.fetch_add(elements * counters.element_size, std::memory_order_relaxed);
+    uint64_t peak = counters.peak_capacity.load(std::memory_order_relaxed);
+    while (elements > peak &&
+           !counters.peak_capacity.compare_exchange_weak(peak, elements, std::memory_order_relaxed)) {
+    }
+  }
+
+  template <class Owner>
+  static void OnGrow(size_t, size_t) {
+    CountersOf<Owner>().growths.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  template <class Owner>
+  static void OnMove(size_t count) {
+    if (count != 0) {
+      CountersOf<Owner>().moved_elements.fetch_add(count, std::memory_order_relaxed);
+    }
+  }
+
+  template <class Owner>
+  static VectorCounters& CountersOf() {
+    static VectorCounters& counters =
+        VectorStatsRegistry::Instance().Register(VectorTypeName<Owner>(), sizeof(typename Owner::ValueType));
+    return counters;
+  }
+};
+
+#endif  // VECTOR_STATS_H_